@@ -35,6 +35,42 @@ inline auto setNumResultsForAAD(const bool multi = false, const size_t numResult
 	return make_unique<numResultsResetterForAAD>();
 }
 
+#ifdef AADPROFILE
+
+#include <iostream>
+#include <string>
+
+//	RAII: report what the tape recorded over the scope on destruction
+//	Nested scopes report their own share, which the enclosing scope also counts
+class TapeProfileScope
+{
+	Tape&			myTape;
+	string			myName;
+	ostream&		myOut;
+	TapeProfile		myStart;
+
+public:
+
+	explicit TapeProfileScope(string name, ostream& out = cerr, Tape& tape = *Number::tape)
+		: myTape(tape), myName(move(name)), myOut(out), myStart(tape.profile()) {}
+
+	TapeProfileScope(const TapeProfileScope&) = delete;
+	TapeProfileScope& operator=(const TapeProfileScope&) = delete;
+
+	//	Recorded so far in the scope
+	TapeProfile recorded() const
+	{
+		return myTape.profile() - myStart;
+	}
+
+	~TapeProfileScope()
+	{
+		recorded().report(myOut, myName);
+	}
+};
+
+#endif
+
 //  Other utilities
 
 //	Put collection on tape
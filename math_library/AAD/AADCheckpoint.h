@@ -0,0 +1,110 @@
+#pragma once
+
+//  Checkpointed adjoint propagation of a long recursion
+//      state_k+1 = step(k, params, state_k), k = 0..numSteps - 1, result = payoff(params, state_numSteps)
+//  The forward pass runs in doubles off tape and keeps the state every interval steps (checkpoints)
+//  The backward pass takes the segments between checkpoints from the last one: it rewinds the tape to its mark,
+//      puts the checkpoint state on tape, records the segment's steps (and the payoff for the last one),
+//      seeds the adjoints of the segment's end state with those of the start of the segment after it and propagates
+//      them to the mark
+//  So the tape never holds more than one segment: with the default interval, sqrt(numSteps), tape memory is
+//      O(sqrt(numSteps)) nodes and checkpoints O(sqrt(numSteps)) states, for one more forward pass in doubles
+//  step and payoff are generic in the number type, called with vector<double> and vector<Number>:
+//      template <class T> void step(size_t k, const vector<T>& params, vector<T>& state), updating state in place
+//      template <class T> T payoff(const vector<T>& params, const vector<T>& state)
+//  The parameters are Numbers on the tape before its mark, their adjoints accumulate d result / d param,
+//      as propagateToMark would with the whole recursion on tape; single adjoint only (Tape::multi off)
+
+#include <cmath>
+#include <vector>
+#include "AAD.h"
+
+class CheckpointedAdjoint
+{
+    vector<double>  myParams;
+    vector<double>  myCheckpoints;  //  state at steps 0, interval, 2 interval...
+    vector<double>  myState;
+    vector<double>  myAdjoints;     //  adjoints of the start state of the segment after the current one
+    vector<Number>  mySegmentStart;
+    vector<Number>  mySegment;
+    size_t          myPeakNodes = 0;
+
+public:
+
+    //  Steps between checkpoints, 0 for round(sqrt(numSteps))
+    size_t interval = 0;
+
+    //  Result of the recursion from initialState, adjoints of params accumulated
+    //  Adjoints of the initial state are left in initialStateAdjoints()
+    template <class Step, class Payoff>
+    double propagate(
+        vector<Number>&         params,
+        const vector<double>&   initialState,
+        const size_t            numSteps,
+        Step&&                  step,
+        Payoff&&                payoff)
+    {
+        Tape& tape = *Number::tape;
+        const size_t n = initialState.size();
+        const size_t every = interval ? interval : max(size_t(1), size_t(llround(sqrt(double(numSteps)))));
+        const size_t numSegments = max(size_t(1), (numSteps + every - 1) / every);
+
+        //  Forward pass in doubles, keeping the checkpoints
+        myParams.resize(params.size());
+        for (size_t i = 0; i < params.size(); ++i) myParams[i] = params[i].value();
+        myCheckpoints.resize(numSegments * n);
+        myState = initialState;
+        for (size_t k = 0; k < numSteps; ++k)
+        {
+            if (k % every == 0) copy(myState.begin(), myState.end(), myCheckpoints.begin() + (k / every) * n);
+            step(k, myParams, myState);
+        }
+        if (numSteps == 0) copy(myState.begin(), myState.end(), myCheckpoints.begin());
+        const double result = payoff(myParams, myState);
+
+        //  Backward pass, one segment on tape at a time
+        myAdjoints.assign(n, 0.0);
+        mySegment.resize(n);
+        myPeakNodes = 0;
+        for (size_t s = numSegments; s-- > 0;)
+        {
+            tape.rewindToMark();
+            for (size_t i = 0; i < n; ++i) mySegment[i] = Number(myCheckpoints[s * n + i]);
+            mySegmentStart = mySegment;
+
+            const size_t first = s * every, last = min(numSteps, first + every);
+            for (size_t k = first; k < last; ++k) step(k, params, mySegment);
+
+            if (s + 1 == numSegments)
+            {
+                Number h = payoff(params, mySegment);
+                h.adjoint() = 1.0;
+            }
+            else
+            {
+                //  += as state entries may share a node
+                for (size_t i = 0; i < n; ++i) mySegment[i].adjoint() += myAdjoints[i];
+            }
+
+            myPeakNodes = max(myPeakNodes, tape.sizeSinceMark());
+
+            Number::propagateAdjoints(prev(tape.end()), tape.markIt());
+            for (size_t i = 0; i < n; ++i) myAdjoints[i] = mySegmentStart[i].adjoint();
+        }
+        tape.rewindToMark();
+
+        return result;
+    }
+
+    //  d result / d initial state of the last propagation
+    const vector<double>& initialStateAdjoints() const
+    {
+        return myAdjoints;
+    }
+
+    //  Most nodes on tape past the mark in the last propagation, one segment's worth
+    size_t peakNodes() const
+    {
+        return myPeakNodes;
+    }
+};
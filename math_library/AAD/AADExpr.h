@@ -109,6 +109,16 @@ public:
                 adjoint * OP::rightDerivative(lhs.value(), rhs.value(), value()));
         }
     }
+
+#ifdef AADPROFILE
+    //  Count the operations of the expression
+    static void recordOps(TapeProfile& profile)
+    {
+        profile.recordOp(TapeProfile::opIndex<OP>());
+        LHS::recordOps(profile);
+        RHS::recordOps(profile);
+    }
+#endif
 };
 
 //  "Concrete" binaries, we only need to define operations and derivatives
@@ -357,6 +367,14 @@ public:
                 adjoint * OP::derivative(arg.value(), value(), dArg));
         }
     }
+
+#ifdef AADPROFILE
+    static void recordOps(TapeProfile& profile)
+    {
+        profile.recordOp(TapeProfile::opIndex<OP>());
+        ARG::recordOps(profile);
+    }
+#endif
 };
 
 //  The unary operators
@@ -484,6 +502,20 @@ struct OPNormalCdf
     }
 };
 
+struct OPInvNormalCdf
+{
+    static const double eval(const double r, const double d)
+    {
+        return invNormalCdf(r);
+    }
+
+    static const double derivative
+    (const double r, const double v, const double d)
+    {
+        return 1.0 / normalDens(v);
+    }
+};
+
 //  Binary operators with a double on one side 
 
 //  * double or double *
@@ -692,6 +724,12 @@ UnaryExpression<ARG, OPNormalCdf> normalCdf(const Expression<ARG>& arg)
     return UnaryExpression<ARG, OPNormalCdf>(arg);
 }
 
+template <class ARG>
+UnaryExpression<ARG, OPInvNormalCdf> invNormalCdf(const Expression<ARG>& arg)
+{
+    return UnaryExpression<ARG, OPInvNormalCdf>(arg);
+}
+
 //  Overloading continued,
 //      binary operators with a double on one side 
 
@@ -939,6 +977,10 @@ class Number : public Expression<Number>
         static_cast<const E&>(e).pushAdjoint<E::numNumbers, 0>(*node, 1.0);
         //  Set my node
         myNode = node;
+
+#ifdef AADPROFILE
+        E::recordOps(tape->myProfile);
+#endif
     }
 
 public:
@@ -968,6 +1010,11 @@ public:
         exprNode.pDerivatives[n] = adjoint;
     }
 
+#ifdef AADPROFILE
+    //  Leaves of expressions, no operation
+    static void recordOps(TapeProfile&) {}
+#endif
+
     //  Static access to tape, same as traditional
     static thread_local Tape* tape;
 
@@ -1089,8 +1136,8 @@ public:
     {
         //  Set this adjoint to 1
         adjoint() = 1.0;
-        //  Find node on tape
-        auto it = tape->find(myNode);
+        //  Node's position on tape
+        auto it = tape->at(myNode);
         //  Reverse and propagate until we hit the stop
         while (it != propagateTo)
         {
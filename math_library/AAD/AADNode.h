@@ -40,6 +40,9 @@ class Node
     //  Variable of childs (arguments)
     const size_t    n;
 
+    //  Index of the tape block holding the node, see Tape::at
+    size_t          mBlock = 0;
+
 public:
 
     //  Data lives in separate memory
@@ -0,0 +1,137 @@
+#pragma once
+
+//  Tape profiler, compiled in with AADPROFILE defined
+//  The tape counts what it records: nodes by arity, derivatives, argument pointers and multi-dimensional adjoints,
+//      and with expression templates the operations flattened into each node
+//  Counts are cumulative, Tape::profile() less a snapshot is what a scope recorded,
+//      including what was rewound since; snapshots are taken at rewind and mark, or by a TapeProfileScope
+//  Nodes of many operations are expressions collapsed by the templates, many nodes of one or two operations
+//      point at code that breaks expressions up into Numbers
+
+#include <algorithm>
+#include <array>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+using namespace std;
+
+struct TapeProfile
+{
+    //  Arities above are counted together
+    static constexpr size_t maxArity = 8;
+
+    size_t  nodes = 0;
+    size_t  derivatives = 0;
+    size_t  argPtrs = 0;
+    size_t  adjoints = 0;
+
+    //  Nodes by number of arguments, the last bucket counts more than maxArity
+    array<size_t, maxArity + 2>     arity = {};
+
+    //  Operations by index, see opIndex
+    vector<size_t>                  ops;
+
+    //  Peak bytes of the storages of the tape, since its construction
+    size_t  peakNodeBytes = 0;
+    size_t  peakDerBytes = 0;
+    size_t  peakArgPtrBytes = 0;
+    size_t  peakAdjointBytes = 0;
+
+    //  Record one node of N arguments with numAdj adjoints held on the side
+    void recordNode(const size_t N, const size_t numAdj)
+    {
+        ++nodes;
+        derivatives += N;
+        argPtrs += N;
+        adjoints += numAdj;
+        ++arity[min(N, maxArity + 1)];
+    }
+
+    void recordOp(const size_t index)
+    {
+        if (ops.size() <= index) ops.resize(index + 1, 0);
+        ++ops[index];
+    }
+
+    //  Index of an operation (OP* struct of AADExpr.h), given on its first use
+    template <class OP>
+    static size_t opIndex()
+    {
+        static const size_t index = registerOp(typeid(OP).name());
+        return index;
+    }
+
+    //  Name of operation i, OP prefix removed
+    static string opName(const size_t i)
+    {
+        lock_guard<mutex> lock(registryMutex());
+        return opNames()[i];
+    }
+
+    //  Counts recorded since the snapshot, peaks of this profile
+    TapeProfile operator-(const TapeProfile& snapshot) const
+    {
+        TapeProfile diff = *this;
+        diff.nodes -= snapshot.nodes;
+        diff.derivatives -= snapshot.derivatives;
+        diff.argPtrs -= snapshot.argPtrs;
+        diff.adjoints -= snapshot.adjoints;
+        for (size_t i = 0; i < arity.size(); ++i) diff.arity[i] -= snapshot.arity[i];
+        for (size_t i = 0; i < snapshot.ops.size() && i < diff.ops.size(); ++i) diff.ops[i] -= snapshot.ops[i];
+        return diff;
+    }
+
+    //  Counts, arities, operations (most frequent first) and peak bytes
+    void report(ostream& out, const string& title) const
+    {
+        out << title << ": " << nodes << " nodes, " << derivatives << " derivatives, "
+            << argPtrs << " argument pointers, " << adjoints << " adjoints" << endl;
+
+        out << "  arity:";
+        for (size_t i = 0; i < arity.size(); ++i)
+        {
+            if (arity[i]) out << " " << (i > maxArity ? ">" + to_string(maxArity) : to_string(i)) << ": " << arity[i];
+        }
+        out << endl;
+
+        vector<size_t> order;
+        for (size_t i = 0; i < ops.size(); ++i) if (ops[i]) order.push_back(i);
+        stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return ops[a] > ops[b]; });
+        if (!order.empty())
+        {
+            out << "  operations:";
+            for (size_t i : order) out << " " << opName(i) << ": " << ops[i];
+            out << endl;
+        }
+
+        out << "  peak bytes: nodes " << peakNodeBytes << ", derivatives " << peakDerBytes
+            << ", argument pointers " << peakArgPtrBytes << ", adjoints " << peakAdjointBytes << endl;
+    }
+
+private:
+
+    static mutex& registryMutex()
+    {
+        static mutex m;
+        return m;
+    }
+
+    static vector<string>& opNames()
+    {
+        static vector<string> names;
+        return names;
+    }
+
+    //  typeid names are compiler specific: "6OPMult" (GCC, Clang), "struct OPMult" (MSVC)
+    static size_t registerOp(string name)
+    {
+        const size_t start = name.find("OP");
+        if (start != string::npos) name = name.substr(start + 2);
+        lock_guard<mutex> lock(registryMutex());
+        opNames().push_back(name);
+        return opNames().size() - 1;
+    }
+};
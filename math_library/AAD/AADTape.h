@@ -20,6 +20,10 @@ As long as this comment is preserved at the top of the file
 #include "blocklist.h"
 #include "AADNode.h"
 
+#ifdef AADPROFILE
+#include "AADProfile.h"
+#endif
+
 constexpr size_t BLOCKSIZE  = 16384;		//	Number of nodes
 constexpr size_t ADJSIZE    = 32768;		//	Number of adjoints
 constexpr size_t DATASIZE   = 65536;		//	Data in bytes
@@ -36,6 +40,13 @@ class Tape
     //  Storage for the nodes
 	blocklist<Node, BLOCKSIZE>		    myNodes;
 
+#ifdef AADPROFILE
+    //  Cumulative counts, and their snapshots at the last rewind and mark
+    TapeProfile                         myProfile;
+    TapeProfile                         myRewindProfile;
+    TapeProfile                         myMarkProfile;
+#endif
+
 	//	Padding so tapes in a vector don't interfere
     char                                myPad[64];
 
@@ -48,6 +59,13 @@ class Tape
 
 public:
 
+    //  Blocks on the heap, one allocation each
+    Tape() = default;
+
+    //  Blocks adjacent in arenas of virtual memory (see ArenaOptions), one per storage
+    explicit Tape(const ArenaOptions& options) :
+        myAdjointsMulti(options), myDers(options), myArgPtrs(options), myNodes(options) {}
+
     //  Build note in place and return a pointer
 	//	N : number of childs (arguments)
     template <size_t N>
@@ -55,6 +73,11 @@ public:
     {
         //  Construct the node in place on tape
         Node* node = myNodes.emplace_back(N);
+        node->mBlock = myNodes.block_index();
+
+#ifdef AADPROFILE
+        myProfile.recordNode(N, multi ? Node::numAdj : 0);
+#endif
         
         //  Store and zero the adjoint(s)
         if (multi)
@@ -90,9 +113,52 @@ public:
 		}
 	}
 
+    //  Reserve blocks for numNodes nodes with numArgs arguments (in total) and their adjoints
+    //      so that recording that much does not allocate
+    void reserve(const size_t numNodes, const size_t numArgs)
+    {
+        if (multi)
+        {
+            myAdjointsMulti.reserve(numNodes * Node::numAdj);
+        }
+        myDers.reserve(numArgs);
+        myArgPtrs.reserve(numArgs);
+        myNodes.reserve(numNodes);
+    }
+
+#ifdef AADPROFILE
+
+    //  Everything recorded since construction, with the peak bytes of each storage
+    TapeProfile profile() const
+    {
+        TapeProfile profile = myProfile;
+        profile.peakNodeBytes = myNodes.peak_bytes();
+        profile.peakDerBytes = myDers.peak_bytes();
+        profile.peakArgPtrBytes = myArgPtrs.peak_bytes();
+        profile.peakAdjointBytes = myAdjointsMulti.peak_bytes();
+        return profile;
+    }
+
+    //  Recorded since the last rewind or clear
+    TapeProfile profileSinceRewind() const
+    {
+        return profile() - myRewindProfile;
+    }
+
+    //  Recorded since the last mark, including what was rewound to it since
+    TapeProfile profileSinceMark() const
+    {
+        return profile() - myMarkProfile;
+    }
+
+#endif
+
     //  Clear
     void clear()
     {
+#ifdef AADPROFILE
+        myRewindProfile = profile();
+#endif
         myAdjointsMulti.clear();
 		myDers.clear();
 		myArgPtrs.clear();
@@ -102,6 +168,9 @@ public:
     //  Rewind
     void rewind()
     {
+#ifdef AADPROFILE
+        myRewindProfile = profile();
+#endif
 
 #ifdef _DEBUG
 
@@ -128,6 +197,9 @@ public:
     //  Set mark
     void mark()
     {
+#ifdef AADPROFILE
+        myMarkProfile = profile();
+#endif
         if (multi)
         {
             myAdjointsMulti.setmark();
@@ -168,8 +240,21 @@ public:
         return myNodes.mark();
     }
 
+    //  Nodes recorded since the mark, in constant time
+    size_t sizeSinceMark() const
+    {
+        return myNodes.size_since_mark();
+    }
+
+    //  Linear search from the end, finds nodes that may not be on tape (end() then)
     auto find(Node* node)
     {
         return myNodes.find(node);
     }
+
+    //  Iterator on a node recorded on this tape, in constant time
+    iterator at(Node* node)
+    {
+        return myNodes.at(node->mBlock, node);
+    }
 };
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+//  Tapes for parallel adjoint differentiation
+
+#include <memory>
+#include <optional>
+#include <vector>
+#include "AAD.h"
+
+//  Number::tape is thread local but every thread starts on the same global tape,
+//      so threads recording at the same time must each be pointed at a tape of their own
+//  The pool keeps one tape per worker with its blocks across uses:
+//      worker t calls use(t) before it creates any Number,
+//      puts its own copy of the model parameters on its tape once, then records paths after a mark
+//      and hands its parameters' adjoints to the caller, who sums them across workers
+//  Tapes are allocated separately, so a worker's nodes never share a cache line with another's
+class TapePool
+{
+    vector<unique_ptr<Tape>> myTapes;
+
+public:
+
+    //  Tapes created by prepare from now on keep their blocks in arenas when set
+    optional<ArenaOptions> arena;
+
+    //  RAII: points the calling thread at a tape, back to its previous tape on destruction
+    class Scope
+    {
+        Tape* myPrevious;
+
+    public:
+
+        explicit Scope(Tape& tape) : myPrevious(Number::tape)
+        {
+            Number::tape = &tape;
+        }
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+        ~Scope()
+        {
+            Number::tape = myPrevious;
+        }
+    };
+
+    //  At least numTapes tapes, each with blocks reserved for numNodes nodes of argsPerNode arguments on average
+    void prepare(const size_t numTapes, const size_t numNodes = 0, const size_t argsPerNode = 2)
+    {
+        while (myTapes.size() < numTapes)
+        {
+            myTapes.push_back(arena ? make_unique<Tape>(*arena) : make_unique<Tape>());
+        }
+        for (auto& tape : myTapes)
+        {
+            tape->reserve(numNodes, numNodes * argsPerNode);
+        }
+    }
+
+    size_t size() const
+    {
+        return myTapes.size();
+    }
+
+    Tape& operator[](const size_t i)
+    {
+        return *myTapes[i];
+    }
+
+    //  Record on tape i on the calling thread for the lifetime of the returned scope
+    Scope use(const size_t i)
+    {
+        return Scope(*myTapes[i]);
+    }
+};
@@ -184,7 +184,7 @@ public:
         //  Set this adjoint to 1
         adjoint() = 1.0;
         //  Find node on tape
-        auto propagateFrom = tape->find(myNode);
+        auto propagateFrom = tape->at(myNode);
         propagateAdjoints(propagateFrom, propagateTo);
     }
 
@@ -610,6 +610,17 @@ public:
         return result;
     }
 
+    inline friend Variable invNormalCdf(const Variable& arg)
+    {
+        const double e = invNormalCdf(arg.value());
+        //  Eagerly evaluate and put on tape
+		Variable result(arg.node(), e);
+        //  Eagerly compute derivatives
+		result.derivative() = 1.0 / normalDens(e);
+
+        return result;
+    }
+
     //  Finally, comparison
 
     inline friend bool operator==(const Variable& lhs, const Variable& rhs)
@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+#include <cmath>
+#include <sstream>
+#include <vector>
+#include "AAD.h"
+#include "AADTapePool.h"
+#include "AADCheckpoint.h"
+
+TEST(AADTest, NormalFunctionsDifferentiate) {
+    Number::tape->rewind();
+    Number p(0.3), x(-1.2);
+    Number y = invNormalCdf(p) + normalCdf(x);
+    y.propagateToStart();
+    EXPECT_NEAR(p.adjoint(), 1.0 / normalDens(invNormalCdf(0.3)), 1e-12);
+    EXPECT_NEAR(x.adjoint(), normalDens(-1.2), 1e-15);
+    EXPECT_NEAR(normalCdf(-1.2), 0.11506967022170822, 1e-16);
+    Number::tape->rewind();
+}
+
+TEST(AADTest, PropagatesFromNodesPastTheFirstBlock) {
+    // the result is recorded in the second block of the tape and more is recorded after it,
+    // propagation starts from its node wherever it lies, also once the tape is rewound and its blocks reused
+    const double a = 0.9999;
+    const size_t n = BLOCKSIZE + BLOCKSIZE / 4;
+    for (int pass = 0; pass < 2; pass++) {
+        Number::tape->rewind();
+        Number x(0.5), y(1.0), result;
+        Number::tape->mark();
+        for (size_t i = 0; i < n + BLOCKSIZE; i++) {
+            y = y * a + x;
+            if (i == n) result = y;
+        }
+        // one node per step, counted across blocks
+        EXPECT_EQ(Number::tape->sizeSinceMark(), n + BLOCKSIZE) << pass;
+        result.propagateToStart();
+        EXPECT_NEAR(x.adjoint(), (1.0 - pow(a, double(n + 1))) / (1.0 - a), 1e-8) << pass;
+    }
+    Number::tape->rewind();
+}
+
+TEST(AADTest, ArenaTapeKeepsBlocksAdjacent) {
+    ArenaOptions options;
+    options.reserveBytes = size_t(1) << 30;
+    options.highWaterBytes = 2 * BLOCKSIZE * sizeof(Node);
+    Tape tape(options);
+    const TapePool::Scope scope(tape);
+    const double a = 0.9999;
+    const size_t n = 3 * BLOCKSIZE;
+    for (int pass = 0; pass < 2; pass++) {
+        // the first rewind returns the blocks above the high-water mark, the second pass carves them again
+        tape.rewind();
+        Number x(0.5), y(1.0);
+        for (size_t i = 0; i < n; i++) y = y * a + x;
+        y.propagateToStart();
+        EXPECT_NEAR(x.adjoint(), (1.0 - pow(a, double(n))) / (1.0 - a), 1e-8) << pass;
+
+        // consecutive nodes are adjacent, across blocks too (block header and cache line padding apart)
+        size_t largestGap = 0;
+        const char* previous = nullptr;
+        for (Node& node : tape) {
+            const char* address = reinterpret_cast<const char*>(&node);
+            if (previous) largestGap = max(largestGap, size_t(address - previous));
+            previous = address;
+        }
+        EXPECT_LT(largestGap, sizeof(Node) + 128) << pass;
+    }
+    tape.rewind();
+}
+
+#ifdef AADPROFILE
+TEST(AADTest, ProfileCountsNodesAndOperations) {
+    Tape& tape = *Number::tape;
+    tape.rewind();
+    Number x(0.5), y(1.0);
+    tape.mark();
+    for (int i = 0; i < 10; i++) {
+        tape.rewindToMark();
+        y = y * 0.9 + x;
+        Number z = exp(y);
+    }
+
+    // two leaves, then ten times one node on y and x and one on y
+    const TapeProfile recorded = tape.profileSinceRewind();
+    EXPECT_EQ(recorded.nodes, 22u);
+    EXPECT_EQ(recorded.derivatives, 30u);
+    EXPECT_EQ(recorded.argPtrs, 30u);
+    EXPECT_EQ(recorded.arity[0], 2u);
+    EXPECT_EQ(recorded.arity[1], 10u);
+    EXPECT_EQ(recorded.arity[2], 10u);
+    EXPECT_EQ(recorded.ops[TapeProfile::opIndex<OPMultD>()], 10u);
+    EXPECT_EQ(recorded.ops[TapeProfile::opIndex<OPAdd>()], 10u);
+    EXPECT_EQ(recorded.ops[TapeProfile::opIndex<OPExp>()], 10u);
+    EXPECT_GE(recorded.peakNodeBytes, BLOCKSIZE * sizeof(Node));
+    EXPECT_EQ(tape.profileSinceMark().nodes, 20u);
+
+    ostringstream out;
+    {
+        TapeProfileScope scope("payoff", out);
+        Number w = x * y + x * x;
+        EXPECT_EQ(scope.recorded().nodes, 1u);
+    }
+    // expression templates give every occurrence of a Number an argument of its own
+    EXPECT_NE(out.str().find("payoff: 1 nodes, 4 derivatives"), string::npos) << out.str();
+    EXPECT_NE(out.str().find("Mult: 2 Add: 1"), string::npos) << out.str();
+    tape.rewind();
+}
+#endif
+
+TEST(AADTest, CheckpointingMatchesFullTape) {
+    // basket of GBMs on fixed Gaussians, params r and the vols, call on the basket average
+    const size_t assets = 3, steps = 200;
+    vector<double> z(steps * assets);
+    for (size_t i = 0; i < z.size(); i++) z[i] = sin(1.0 + double(i));
+    auto step = [&](size_t k, const auto& params, auto& state) {
+        const double dt = 1.0 / steps;
+        for (size_t a = 0; a < assets; a++) {
+            const auto& vol = params[1 + a];
+            state[a] = state[a] * exp((params[0] - 0.5 * vol * vol) * dt + vol * sqrt(dt) * z[k * assets + a]);
+        }
+    };
+    auto payoff = [&](const auto& params, const auto& state) {
+        using T = decay_t<decltype(state[0])>;
+        const T average = (state[0] + state[1] + state[2]) / 3.0;
+        return T(exp(-params[0]) * max(average - 95.0, 0.0));
+    };
+    const vector<double> S0 = { 100.0, 90.0, 110.0 };
+
+    Tape& tape = *Number::tape;
+    tape.rewind();
+    vector<Number> params = { Number(0.05), Number(0.2), Number(0.3), Number(0.25) };
+    tape.mark();
+    vector<Number> S = { Number(S0[0]), Number(S0[1]), Number(S0[2]) };
+    const vector<Number> start = S;
+    for (size_t k = 0; k < steps; k++) step(k, params, S);
+    Number h = payoff(params, S);
+    size_t fullNodes = 0;
+    for (auto it = tape.markIt(); it != tape.end(); ++it) fullNodes++;
+    EXPECT_EQ(tape.sizeSinceMark(), fullNodes);
+    h.propagateToMark();
+    vector<double> paramAdjoints, stateAdjoints;
+    for (Number& p : params) paramAdjoints.push_back(p.adjoint());
+    for (const Number& s : start) stateAdjoints.push_back(s.adjoint());
+
+    CheckpointedAdjoint checkpointed;
+    for (size_t interval : { 0, 1, 7, 200, 1000 }) {
+        for (Number& p : params) p.adjoint() = 0.0;
+        checkpointed.interval = interval;
+        EXPECT_NEAR(checkpointed.propagate(params, S0, steps, step, payoff), h.value(), 1e-12) << interval;
+        for (size_t i = 0; i < params.size(); i++)
+            EXPECT_NEAR(params[i].adjoint(), paramAdjoints[i], 1e-10 * abs(paramAdjoints[i])) << interval << " " << i;
+        for (size_t a = 0; a < assets; a++)
+            EXPECT_NEAR(checkpointed.initialStateAdjoints()[a], stateAdjoints[a], 1e-12) << interval << " " << a;
+        // one segment of sqrt(steps) on tape instead of the whole path
+        if (interval == 0) {
+            EXPECT_LT(checkpointed.peakNodes() * 10, fullNodes);
+        }
+    }
+    tape.rewind();
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+//  Arena backend for blocklist: one range of virtual memory reserved up front,
+//      blocks carved out of it one after the other so they are adjacent in memory,
+//      pages committed when first used and handed back to the OS above a high-water mark
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+struct ArenaOptions
+{
+    //  Virtual address range reserved per blocklist, no memory is committed for it
+    size_t  reserveBytes = size_t(1) << 34;
+
+    //  Ask for transparent huge pages on the range (Linux), fewer TLB misses on large tapes
+    bool    hugePages = false;
+
+    //  rewind and clear keep this much memory committed and return the rest to the OS
+    size_t  highWaterBytes = size_t(1) << 28;
+};
+
+class Arena
+{
+    char*       myMapping;      //  start of the reservation
+    size_t      myMappingSize;
+    char*       myBase;         //  start of the usable range, aligned
+    char*       myEnd;
+    char*       myTop;          //  next free byte
+    char*       myCommitted;    //  end of the pages that may hold memory
+    size_t      myLive = 0;     //  allocations not yet returned
+    size_t      myPage;
+    size_t      myHighWater;
+
+    static constexpr size_t hugePageSize = size_t(1) << 21;
+    //  Windows commits in steps of this many bytes
+    static constexpr size_t commitStep = size_t(1) << 21;
+
+    static char* roundUp(char* p, const size_t to)
+    {
+        return reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(p) + to - 1) / to * to);
+    }
+
+public:
+
+    explicit Arena(const ArenaOptions& options) : myHighWater(options.highWaterBytes)
+    {
+        //  Reserve one huge page more so the usable range can start on a huge page boundary
+        myMappingSize = options.reserveBytes + hugePageSize;
+
+#ifdef _WIN32
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        myPage = si.dwPageSize;
+        myMapping = static_cast<char*>(VirtualAlloc(nullptr, myMappingSize, MEM_RESERVE, PAGE_NOACCESS));
+        if (!myMapping) throw bad_alloc();
+#else
+        myPage = size_t(sysconf(_SC_PAGESIZE));
+        void* p = mmap(nullptr, myMappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (p == MAP_FAILED) throw bad_alloc();
+        myMapping = static_cast<char*>(p);
+#endif
+
+        myBase = roundUp(myMapping, hugePageSize);
+        myEnd = myBase + options.reserveBytes;
+        myTop = myCommitted = myBase;
+
+#if !defined(_WIN32) && defined(MADV_HUGEPAGE)
+        if (options.hugePages) madvise(myBase, options.reserveBytes, MADV_HUGEPAGE);
+#endif
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    ~Arena()
+    {
+#ifdef _WIN32
+        VirtualFree(myMapping, 0, MEM_RELEASE);
+#else
+        munmap(myMapping, myMappingSize);
+#endif
+    }
+
+    //  Next bytes of the range, aligned
+    //      sizes are rounded up to the alignment so the allocations of one alignment follow each other
+    //      without padding and deallocating the last ones in reverse order brings the top back
+    void* allocate(const size_t bytes, const size_t alignment)
+    {
+        char* p = roundUp(myTop, alignment);
+        char* top = roundUp(p + bytes, alignment);
+        if (top > myEnd) throw bad_alloc();
+        myTop = top;
+        ++myLive;
+
+        if (myTop > myCommitted)
+        {
+#ifdef _WIN32
+            char* committed = min(roundUp(myTop, commitStep), myEnd);
+            if (!VirtualAlloc(myCommitted, committed - myCommitted, MEM_COMMIT, PAGE_READWRITE)) throw bad_alloc();
+            myCommitted = committed;
+#else
+            //  Anonymous pages are committed by the OS when first touched
+            myCommitted = roundUp(myTop, myPage);
+#endif
+        }
+
+        return p;
+    }
+
+    //  The last allocation is given back to the range, others when all are returned
+    void deallocate(void* p, const size_t bytes, const size_t alignment)
+    {
+        if (roundUp(static_cast<char*>(p) + bytes, alignment) == myTop) myTop = static_cast<char*>(p);
+        if (--myLive == 0) myTop = myBase;
+    }
+
+    //  Return the pages above the high-water mark that nothing lives in to the OS
+    void trim()
+    {
+        char* keep = roundUp(max(myTop, myBase + min(myHighWater, size_t(myEnd - myBase))), myPage);
+        if (keep >= myCommitted) return;
+
+#ifdef _WIN32
+        VirtualFree(keep, myCommitted - keep, MEM_DECOMMIT);
+#else
+        madvise(keep, myCommitted - keep, MADV_DONTNEED);
+#endif
+        myCommitted = keep;
+    }
+
+    //  Bytes of the high-water mark
+    size_t highWater() const
+    {
+        return myHighWater;
+    }
+
+    //  Bytes that may hold memory: allocated, or committed and kept below the high-water mark
+    size_t committed() const
+    {
+        return myCommitted - myBase;
+    }
+};
+
+//  Allocator on an arena, or on the heap when it has none
+template <class T>
+class ArenaAllocator
+{
+    template <class U> friend class ArenaAllocator;
+
+    Arena* myArena;
+
+public:
+
+    using value_type = T;
+
+    explicit ArenaAllocator(Arena* arena = nullptr) : myArena(arena) {}
+
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U>& rhs) : myArena(rhs.myArena) {}
+
+    T* allocate(const size_t n)
+    {
+        //  Cache line aligned so blocks do not share lines
+        const size_t alignment = max(alignof(T), size_t(64));
+        if (myArena) return static_cast<T*>(myArena->allocate(n * sizeof(T), alignment));
+        return static_cast<T*>(::operator new(n * sizeof(T), align_val_t(alignment)));
+    }
+
+    void deallocate(T* p, const size_t n)
+    {
+        const size_t alignment = max(alignof(T), size_t(64));
+        if (myArena) myArena->deallocate(p, n * sizeof(T), alignment);
+        else ::operator delete(p, align_val_t(alignment));
+    }
+
+    Arena* arena() const
+    {
+        return myArena;
+    }
+
+    template <class U> bool operator==(const ArenaAllocator<U>& rhs) const { return myArena == rhs.myArena; }
+    template <class U> bool operator!=(const ArenaAllocator<U>& rhs) const { return myArena != rhs.myArena; }
+};
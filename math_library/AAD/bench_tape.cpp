@@ -0,0 +1,135 @@
+#include <chrono>
+#include <iostream>
+#include "AAD.h"
+#include "AADTapePool.h"
+#include "AADCheckpoint.h"
+
+// Starting a propagation from a node on a 10M-node tape: Tape::find, the linear search from the end of the tape,
+// against Tape::at, the constant time lookup through the node's block index, and both against the backward
+// sweep itself. The node is the result of the first half of the tape, so the search has half the tape to cross,
+// as when a result is differentiated after more of the calculation was recorded
+// Then recording and sweeping again on the rewound tape, with blocks on the heap and in an arena (huge pages),
+// and a 1000-step path of a 10-asset basket differentiated with the whole path on tape against CheckpointedAdjoint
+// Build optimised, e.g. bazel run -c opt //math_library/AAD:bench_tape
+static void run(Tape& tape, const char* name)
+{
+    const size_t numNodes = 10000000, repeats = 5;
+    const TapePool::Scope scope(tape);
+    double check = 0.0, record = 0.0, rerecord = 0.0, sweep = 0.0, find = 0.0, at = 0.0;
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        tape.rewind();
+        auto start = chrono::steady_clock::now();
+        Number x(0.5), y(1.0), result;
+        Node* middle = nullptr;
+        for (size_t i = 0; i < numNodes; i++)
+        {
+            y = y * 0.999999 + x;
+            if (i == numNodes / 2)
+            {
+                middle = &*prev(tape.end());
+                result = y;
+            }
+        }
+        (pass ? rerecord : record) = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        if (pass == 0)
+        {
+            start = chrono::steady_clock::now();
+            for (size_t k = 0; k < repeats; k++) check += tape.find(middle)->adjoint();
+            find = chrono::duration<double>(chrono::steady_clock::now() - start).count() / repeats;
+
+            const size_t lookups = 1000000;
+            start = chrono::steady_clock::now();
+            for (size_t k = 0; k < lookups; k++) check += tape.at(middle)->adjoint();
+            at = chrono::duration<double>(chrono::steady_clock::now() - start).count() / lookups;
+        }
+
+        start = chrono::steady_clock::now();
+        result.propagateToStart();
+        sweep = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        check += x.adjoint();
+    }
+    tape.rewind();
+
+    cout << name << endl;
+    cout << "  recording:      " << record * 1e3 << " ms for " << numNodes << " nodes, " << rerecord * 1e3 << " ms rewound" << endl;
+    cout << "  Tape::find:     " << find * 1e3 << " ms" << endl;
+    cout << "  Tape::at:       " << at * 1e9 << " ns" << endl;
+    cout << "  backward sweep: " << sweep * 1e3 << " ms over " << numNodes / 2 << " nodes (checksum " << check << ")" << endl;
+}
+
+static void runCheckpointed()
+{
+    const size_t assets = 10, steps = 1000, repeats = 20;
+    vector<double> z(steps * assets);
+    for (size_t i = 0; i < z.size(); i++) z[i] = sin(1.0 + double(i));
+    auto step = [&](size_t k, const auto& params, auto& state)
+    {
+        const double dt = 1.0 / steps;
+        for (size_t a = 0; a < assets; a++)
+        {
+            const auto& vol = params[1 + a];
+            state[a] = state[a] * exp((params[0] - 0.5 * vol * vol) * dt + vol * sqrt(dt) * z[k * assets + a]);
+        }
+    };
+    auto payoff = [&](const auto& params, const auto& state)
+    {
+        using T = decay_t<decltype(state[0])>;
+        T sum = state[0];
+        for (size_t a = 1; a < assets; a++) sum = sum + state[a];
+        return T(exp(-params[0]) * max(sum / double(assets) - 100.0, 0.0));
+    };
+    const vector<double> S0(assets, 100.0);
+
+    Tape& tape = *Number::tape;
+    tape.rewind();
+    vector<Number> params;
+    params.emplace_back(0.05);
+    for (size_t a = 0; a < assets; a++) params.emplace_back(0.2 + 0.01 * a);
+    tape.mark();
+
+    double check = 0.0;
+    size_t fullNodes = 0;
+    auto start = chrono::steady_clock::now();
+    for (size_t r = 0; r < repeats; r++)
+    {
+        tape.rewindToMark();
+        vector<Number> S(S0.begin(), S0.end());
+        for (size_t k = 0; k < steps; k++) step(k, params, S);
+        Number h = payoff(params, S);
+        if (r == 0) fullNodes = tape.sizeSinceMark();
+        h.propagateToMark();
+        check += h.value();
+    }
+    const double full = chrono::duration<double>(chrono::steady_clock::now() - start).count() / repeats;
+
+    CheckpointedAdjoint checkpointed;
+    start = chrono::steady_clock::now();
+    for (size_t r = 0; r < repeats; r++) check += checkpointed.propagate(params, S0, steps, step, payoff);
+    const double segmented = chrono::duration<double>(chrono::steady_clock::now() - start).count() / repeats;
+    check += params[1].adjoint();
+    tape.rewind();
+
+    cout << "checkpointing, " << assets << " assets, " << steps << " steps" << endl;
+    cout << "  whole path:     " << full * 1e3 << " ms, " << fullNodes << " nodes on tape" << endl;
+    cout << "  checkpointed:   " << segmented * 1e3 << " ms, " << checkpointed.peakNodes() << " nodes on tape (checksum " << check << ")" << endl;
+}
+
+int main()
+{
+    {
+        Tape heap;
+        run(heap, "heap blocks");
+    }
+    {
+        ArenaOptions options;
+        options.hugePages = true;
+        options.highWaterBytes = size_t(1) << 30;
+        Tape arena(options);
+        run(arena, "arena blocks");
+    }
+    runCheckpointed();
+    return 0;
+}
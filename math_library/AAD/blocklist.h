@@ -19,16 +19,22 @@ As long as this comment is preserved at the top of the file
 //  Blocklist data structure for AAD memory management
 #include <array>
 #include <list>
+#include <vector>
 #include <iterator>
 #include <cstring>
 #include <math.h>
+#include <memory>
+#include "arena.h"
 using namespace std;
 
 template <class T, size_t block_size>
 class blocklist
 {
+    //  Arena the blocks are carved from, none when they are on the heap
+    unique_ptr<Arena>   arena;
+
     //  Container = list of blocks
-    list<array<T, block_size>>  data;
+    list<array<T, block_size>, ArenaAllocator<array<T, block_size>>>  data;
 
     using list_iter = decltype(data.begin());
     using block_iter = decltype(data.back().begin());
@@ -49,11 +55,25 @@ class blocklist
     list_iter           marked_block;
     block_iter          marked_space;
 
+    //  Blocks by position, so an element's iterator is found in constant time from its block's index
+    vector<list_iter>   blocks;
+    size_t              cur_index;
+    size_t              marked_index;
+
+    //  Most blocks held at once
+    size_t              peak_blocks = 0;
+
+    //  Bytes a block takes in the arena: its list node, the array and two links, cache line aligned
+    static constexpr size_t node_bytes = (sizeof(array<T, block_size>) + 2 * sizeof(void*) + 63) / 64 * 64;
+
     //  Create new array
     void newblock()
     {
         data.emplace_back();
         cur_block = last_block = prev(data.end());
+        blocks.push_back(cur_block);
+        cur_index = blocks.size() - 1;
+        peak_blocks = max(peak_blocks, blocks.size());
         next_space = cur_block->begin();
         last_space = cur_block->end();
     }
@@ -69,11 +89,34 @@ class blocklist
         else
         {
             ++cur_block;
+            ++cur_index;
             next_space = cur_block->begin();
             last_space = cur_block->end();
         }
     }
 
+    //  Arena backend: drop the blocks above the high-water mark, from the last one,
+    //      and return their pages to the OS (called when no block is in use past the first)
+    void trim()
+    {
+        if (!arena) return;
+        const size_t keep = max(size_t(1), arena->highWater() / node_bytes);
+        pop_blocks(keep);
+        arena->trim();
+    }
+
+    //  Release the blocks past the first n, from the last one,
+    //      so the arena top comes back down with each of them
+    void pop_blocks(const size_t n)
+    {
+        while (data.size() > n)
+        {
+            data.pop_back();
+            blocks.pop_back();
+        }
+        last_block = prev(data.end());
+    }
+
 public:
 
     //  Create first block on construction
@@ -82,19 +125,50 @@ public:
         newblock();
     }
 
+    //  Arena backend: blocks adjacent in a range of virtual memory reserved on construction
+    //      rewind and clear return the memory above options.highWaterBytes to the OS,
+    //      so marks set before them are lost
+    explicit blocklist(const ArenaOptions& options) :
+        arena(make_unique<Arena>(options)),
+        data(ArenaAllocator<array<T, block_size>>(arena.get()))
+    {
+        newblock();
+    }
+
     //  Factory reset
+    //      the first block is kept: with an arena, list::clear would leave the top up
+    //      where the list allocates its sentinel through the allocator (MSVC)
     void clear()
     {
-        data.clear();
-        newblock();
+        pop_blocks(1);
+        cur_block = data.begin();
+        cur_index = 0;
+        next_space = cur_block->begin();
+        last_space = cur_block->end();
+        if (arena) arena->trim();
     }
 
-    //  Rewind but keep all blocks
+    //  Append blocks until there is room for n elements in total,
+    //      so that filling up to n never allocates (less the ends of blocks emplace_back_multi skips)
+    void reserve(const size_t n)
+    {
+        while (data.size() * block_size < n)
+        {
+            data.emplace_back();
+            last_block = prev(data.end());
+            blocks.push_back(last_block);
+        }
+        peak_blocks = max(peak_blocks, blocks.size());
+    }
+
+    //  Rewind but keep all blocks (below the high-water mark with an arena)
     void rewind()
     {
         cur_block = data.begin();
+        cur_index = 0;
         next_space = cur_block->begin();
         last_space = cur_block->end();
+        trim();
     }
 
 	//	Memset
@@ -201,12 +275,14 @@ public:
         
         marked_block = cur_block;
         marked_space = next_space;
+        marked_index = cur_index;
     }
 
     //  Rewind to mark
     void rewind_to_mark()
     {
         cur_block = marked_block;
+        cur_index = marked_index;
         next_space = marked_space;
 		last_space = cur_block->end();
     }
@@ -318,6 +394,34 @@ public:
             marked_block->begin(), marked_block->end());
     }
 
+    //  Most memory held at once, in bytes
+    size_t peak_bytes() const
+    {
+        return peak_blocks * sizeof(array<T, block_size>);
+    }
+
+    //  Spaces used past the mark, in constant time from the block indices
+    //      (ends of blocks skipped by emplace_back_multi included)
+    size_t size_since_mark() const
+    {
+        return (cur_index - marked_index) * block_size
+            + size_t(next_space - cur_block->begin()) - size_t(marked_space - marked_block->begin());
+    }
+
+    //  Index of the block holding the last element stored
+    size_t block_index() const
+    {
+        return cur_index;
+    }
+
+    //  Iterator on an element of block b, in constant time
+    iterator at(const size_t b, const T* const element)
+    {
+        list_iter block = blocks[b];
+        block_iter space = block->begin() + (element - &*block->begin());
+        return iterator(block, space, block->begin(), block->end());
+    }
+
     //  Find element, by pointer, searching sequentially from the end
     iterator find(const T* const element)
     {
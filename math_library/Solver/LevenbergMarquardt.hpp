@@ -0,0 +1,136 @@
+#pragma once
+#include <array>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace std;
+
+namespace SolverLib {
+	// Levenberg-Marquardt for small nonlinear least squares, min sum_i f_i(x)^2 over N parameters
+	// with box bounds, steps are projected back into the box
+	// residuals(x, f, J) fills the m residuals f and the m x N row-major Jacobian J at x
+	// Buffers are kept across calls, so refitting problems of the same size does not allocate
+	template <size_t N>
+	class LevenbergMarquardt {
+	public:
+		using Parameters = array<double, N>;
+
+		struct Report {
+			unsigned int iterations = 0;
+			double cost = 0.0;		// sum of squared residuals at the solution
+			bool converged = false;
+		};
+
+		double epsx = 1e-10;		// stops once a step is below epsx (1 + |x|)
+		double epsg = 1e-14;		// or the gradient below epsg
+		unsigned int maxIterations = 200;
+		Parameters lower, upper;
+
+		LevenbergMarquardt() {
+			lower.fill(-numeric_limits<double>::infinity());
+			upper.fill(numeric_limits<double>::infinity());
+		}
+
+		template <class Residuals>
+		Report Minimize(Residuals& residuals, size_t m, Parameters& x) {
+			f.resize(m); J.resize(m * N); fTrial.resize(m); JTrial.resize(m * N);
+			Report report;
+			Project(x);
+			residuals(x.data(), f.data(), J.data());
+			double cost = SumOfSquares(f), lambda = 1e-3;
+
+			array<double, N * N> A, L;
+			Parameters g, step, trial;
+			while (report.iterations < maxIterations) {
+				report.iterations++;
+				// normal equations J'J, J'f
+				A.fill(0.0); g.fill(0.0);
+				for (size_t i = 0; i < m; i++) {
+					const double* Ji = &J[i * N];
+					for (size_t r = 0; r < N; r++) {
+						g[r] += Ji[r] * f[i];
+						for (size_t c = 0; c <= r; c++) A[r * N + c] += Ji[r] * Ji[c];
+					}
+				}
+				double gmax = 0.0;
+				for (size_t r = 0; r < N; r++) gmax = max(gmax, abs(g[r]));
+				if (gmax < epsg) { report.converged = true; break; }
+
+				// damping with Marquardt scaling until the step lowers the cost
+				bool accepted = false;
+				while (!accepted && lambda < 1e16) {
+					L = A;
+					for (size_t r = 0; r < N; r++) L[r * N + r] += lambda * max(A[r * N + r], 1e-12);
+					if (!Cholesky(L)) { lambda *= 10.0; continue; }
+					for (size_t r = 0; r < N; r++) step[r] = -g[r];
+					CholeskySolve(L, step);
+					double stepMax = 0.0, xMax = 0.0;
+					for (size_t r = 0; r < N; r++) trial[r] = x[r] + step[r];
+					Project(trial);
+					for (size_t r = 0; r < N; r++) {
+						stepMax = max(stepMax, abs(trial[r] - x[r]));
+						xMax = max(xMax, abs(x[r]));
+					}
+					if (stepMax <= epsx * (1.0 + xMax)) { report.converged = true; break; }
+
+					residuals(trial.data(), fTrial.data(), JTrial.data());
+					const double trialCost = SumOfSquares(fTrial);
+					if (trialCost < cost) {
+						accepted = true;
+						x = trial;
+						cost = trialCost;
+						f.swap(fTrial);
+						J.swap(JTrial);
+						lambda = max(lambda * 0.1, 1e-12);
+					}
+					else lambda *= 10.0;
+				}
+				if (report.converged || !accepted) break;
+			}
+			report.cost = cost;
+			return report;
+		}
+
+	private:
+		vector<double> f, J, fTrial, JTrial;
+
+		void Project(Parameters& x) const {
+			for (size_t r = 0; r < N; r++) x[r] = min(max(x[r], lower[r]), upper[r]);
+		}
+
+		static double SumOfSquares(const vector<double>& v) {
+			double s = 0.0;
+			for (double e : v) s += e * e;
+			return s;
+		}
+
+		// In place lower triangular factor of a symmetric positive definite matrix, false if it is not
+		static bool Cholesky(array<double, N * N>& L) {
+			for (size_t j = 0; j < N; j++) {
+				double d = L[j * N + j];
+				for (size_t k = 0; k < j; k++) d -= L[j * N + k] * L[j * N + k];
+				if (!(d > 0.0)) return false;
+				d = sqrt(d);
+				L[j * N + j] = d;
+				for (size_t i = j + 1; i < N; i++) {
+					double s = L[i * N + j];
+					for (size_t k = 0; k < j; k++) s -= L[i * N + k] * L[j * N + k];
+					L[i * N + j] = s / d;
+				}
+			}
+			return true;
+		}
+
+		static void CholeskySolve(const array<double, N * N>& L, Parameters& b) {
+			for (size_t i = 0; i < N; i++) {
+				for (size_t k = 0; k < i; k++) b[i] -= L[i * N + k] * b[k];
+				b[i] /= L[i * N + i];
+			}
+			for (size_t i = N; i-- > 0;) {
+				for (size_t k = i + 1; k < N; k++) b[i] -= L[k * N + i] * b[k];
+				b[i] /= L[i * N + i];
+			}
+		}
+	};
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <math.h>
+#include <vector>
+using namespace std;
+
+//  Brownian bridge path construction on a uniform time grid
+//  See Glasserman, Monte Carlo Methods in Financial Engineering, 3.1.2
+//  The first Gaussian sets the terminal point, the next ones the midpoints by bisection,
+//  so that the lowest (best distributed) quasi-random dimensions drive most of the path variance
+
+class BrownianBridge
+{
+    size_t          mySteps;
+
+    //  Construction order: point bridgeIndex[i] is built from its left and right neighbours
+    vector<size_t>  myBridgeIndex, myLeftIndex, myRightIndex;
+    vector<double>  myLeftWeight, myRightWeight, myStdDev;
+
+    //  Working memory for the cumulated path
+    vector<double>  myPath;
+
+public:
+
+    BrownianBridge(const size_t steps) : mySteps(steps),
+        myBridgeIndex(steps), myLeftIndex(steps), myRightIndex(steps),
+        myLeftWeight(steps), myRightWeight(steps), myStdDev(steps), myPath(steps)
+    {
+        //  Times in units of the step: t_i = i + 1
+        vector<size_t> map(steps, 0);
+        map[steps - 1] = 1;
+        myBridgeIndex[0] = steps - 1;
+        myStdDev[0] = sqrt(double(steps));
+
+        for (size_t i = 1, j = 0; i < steps; ++i)
+        {
+            //  Next unfilled interval [j, k]
+            while (map[j]) ++j;
+            size_t k = j;
+            while (!map[k]) ++k;
+            const size_t l = j + ((k - 1 - j) >> 1);
+            map[l] = i;
+
+            myBridgeIndex[i] = l;
+            myLeftIndex[i] = j;
+            myRightIndex[i] = k;
+
+            //  Left point is t_{j-1}, or the origin for j = 0
+            const double tl = double(j), tm = double(l + 1), tr = double(k + 1);
+            myLeftWeight[i] = (tr - tm) / (tr - tl);
+            myRightWeight[i] = (tm - tl) / (tr - tl);
+            myStdDev[i] = sqrt((tm - tl) * (tr - tm) / (tr - tl));
+
+            j = k + 1;
+            if (j >= steps) j = 0;
+        }
+    }
+
+    size_t steps() const { return mySteps; }
+
+    //  Turn steps Gaussians z, in order of importance,
+    //  into steps independent standard Gaussian increments dW_k / sqrt(dt)
+    void buildIncrements(const double* z, double* increments)
+    {
+        double* w = myPath.data();
+        w[mySteps - 1] = myStdDev[0] * z[0];
+        for (size_t i = 1; i < mySteps; ++i)
+        {
+            const size_t j = myLeftIndex[i], k = myRightIndex[i], l = myBridgeIndex[i];
+            w[l] = (j ? myLeftWeight[i] * w[j - 1] : 0.0) + myRightWeight[i] * w[k] + myStdDev[i] * z[i];
+        }
+
+        increments[0] = w[0];
+        for (size_t i = 1; i < mySteps; ++i) increments[i] = w[i] - w[i - 1];
+    }
+};
@@ -8,80 +8,59 @@ using namespace std;
 #define EPS 1.0e-08
 
 //  Gaussian functions
+//  CDF and inverse are built on erfc and accurate to ~1e-15,
+//  simd.h has the same family branch-free across registers (Simd::erfc, normalCdf, invNormalCdf)
 
 //  Normal density
 inline double normalDens(const double x)
 {
-    return x<-10.0 || 10.0<x ? 0.0 : exp(-0.5*x*x) / 2.506628274631;
+    return exp(-0.5*x*x) * 0.39894228040143267794;
 }
 
 //	Normal CDF (N in Black-Scholes)
-//  Zelen and Severo's approximation (1964)
-//  See https://en.wikipedia.org/wiki/Normal_distribution#Numerical_approximations_for_the_normal_CDF
+//  N(x) = erfc(-x / sqrt(2)) / 2, no cancellation in the left tail
 inline double normalCdf(const double x)
 {
-	if (x < -10.0) return 0.0;
-	if (x > 10.0) return 1.0;
-    if (x < 0.0) return 1.0 - normalCdf(-x);
-
-	static constexpr double p = 0.2316419;
-	static constexpr double b1 = 0.319381530;
-	static constexpr double b2 = -0.356563782;
-	static constexpr double b3 = 1.781477937;
-	static constexpr double b4 = -1.821255978;
-	static constexpr double b5 = 1.330274429;
-
-	const auto t = 1.0 / (1.0 + p*x);
-
-    const auto pol = t*(b1 + t*(b2 + t*(b3 + t*(b4 + t*b5))));
-
-    const auto pdf = normalDens(x);
-
-	return 1.0 - pdf * pol;
+    return 0.5 * erfc(-x * 0.70710678118654752440);
 }
 
 //	Inverse CDF (for generation of Gaussians out of Uniforms)
-//  Beasley-Springer-Moro algorithm
-//  Moro, The full Monte, Risk, 1995
-//  See Glasserman, Monte Carlo Methods in Financial Engineering, p 68
+//  Acklam's rational approximation (relative error ~1e-9)
+//  polished by one Halley step on normalCdf, so the result is accurate to ~1e-15
 inline double invNormalCdf(const double p)
 {
-    const bool sup = p > 0.5;
-    const double up = sup ? 1.0 - p : p;
-
-	static constexpr double a0 = 2.50662823884;
-	static constexpr double a1 = -18.61500062529;
-	static constexpr double a2 = 41.39119773534;
-	static constexpr double a3 = -25.44106049637;
-
-	static constexpr double b0 = -8.47351093090;
-	static constexpr double b1 = 23.08336743743;
-	static constexpr double b2 = -21.06224101826;
-	static constexpr double b3 = 3.13082909833;
-
-	static constexpr double c0 = 0.3374754822726147;
-	static constexpr double c1 = 0.9761690190917186;
-	static constexpr double c2 = 0.1607979714918209;
-	static constexpr double c3 = 0.0276438810333863;
-	static constexpr double c4 = 0.0038405729373609;
-	static constexpr double c5 = 0.0003951896511919;
-	static constexpr double c6 = 0.0000321767881768;
-	static constexpr double c7 = 0.0000002888167364;
-	static constexpr double c8 = 0.0000003960315187;
-
-	double x = up - 0.5;
-	double r;
-
-	if (fabs(x)<0.42)
+	static constexpr double a[6] = { -3.969683028665376e+01, 2.209460984245205e+02, -2.759285104469687e+02,
+		1.383577518672690e+02, -3.066479806614716e+01, 2.506628277459239e+00 };
+	static constexpr double b[5] = { -5.447609879822406e+01, 1.615858368580409e+02, -1.556989798598866e+02,
+		6.680131188771972e+01, -1.328068155288572e+01 };
+	static constexpr double c[6] = { -7.784894002430293e-03, -3.223964580411365e-01, -2.400758277161838e+00,
+		-2.549732539343734e+00, 4.374664141464968e+00, 2.938163982698783e+00 };
+	static constexpr double d[4] = { 7.784695709041462e-03, 3.224671290700398e-01, 2.445134137142996e+00,
+		3.754408661907416e+00 };
+	static constexpr double pLow = 0.02425;
+
+	if (p <= 0.0) return -HUGE_VAL;
+	if (p >= 1.0) return HUGE_VAL;
+
+	double x;
+	const double q = p - 0.5;
+	if (fabs(q) <= 0.5 - pLow)
 	{
-		r = x*x;
-		r = x*(((a3*r + a2)*r + a1)*r + a0) / ((((b3*r + b2)*r + b1)*r + b0)*r + 1.0);
-		return sup ? -r: r;
+		const double r = q*q;
+		x = (((((a[0]*r + a[1])*r + a[2])*r + a[3])*r + a[4])*r + a[5])*q /
+			(((((b[0]*r + b[1])*r + b[2])*r + b[3])*r + b[4])*r + 1.0);
+	}
+	else
+	{
+		const double t = sqrt(-2.0*log(q < 0.0 ? p : 1.0 - p));
+		x = (((((c[0]*t + c[1])*t + c[2])*t + c[3])*t + c[4])*t + c[5]) /
+			((((d[0]*t + d[1])*t + d[2])*t + d[3])*t + 1.0);
+		if (q > 0.0) x = -x;
 	}
 
-	r = up;
-	r = log(-log(r));
-	r = c0 + r*(c1 + r*(c2 + r*(c3 + r*(c4 + r*(c5 + r*(c6 + r*(c7 + r*c8)))))));
-
-	return sup? r: -r;
+	//  Halley step, the residual taken on the tail side of x
+	const double tail = normalCdf(-fabs(x));
+	const double e = x < 0.0 ? tail - p : (1.0 - p) - tail;
+	const double u = e * 2.50662827463100050242 * exp(0.5*x*x);
+	return x - u / (1.0 + 0.5*x*u);
 }
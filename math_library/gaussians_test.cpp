@@ -0,0 +1,60 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <vector>
+#include "gaussians.h"
+#include "simd.h"
+
+// Applies a SIMD function to xs, one register at a time
+template <class F>
+static std::vector<double> simdApply(const std::vector<double>& xs, F f) {
+    std::vector<double> in(xs), out((xs.size() + Simd::width - 1) / Simd::width * Simd::width);
+    in.resize(out.size(), 0.5);
+    for (size_t i = 0; i < in.size(); i += Simd::width) Simd::storeu(out.data() + i, f(Simd::loadu(in.data() + i)));
+    out.resize(xs.size());
+    return out;
+}
+
+static std::vector<double> grid(double from, double to, size_t n) {
+    std::vector<double> xs(n);
+    for (size_t i = 0; i < n; ++i) xs[i] = from + (to - from) * i / (n - 1);
+    return xs;
+}
+
+TEST(GaussiansTest, SimdErfcMatchesStd) {
+    const auto xs = grid(-6.0, 27.0, 20001);
+    const auto ys = simdApply(xs, [](Simd::vdouble x) { return Simd::erfc(x); });
+    for (size_t i = 0; i < xs.size(); ++i) {
+        const double ref = erfc(xs[i]);
+        EXPECT_LE(std::fabs(ys[i] - ref), 2e-15 * ref + 1e-300) << "x = " << xs[i];
+    }
+}
+
+TEST(GaussiansTest, SimdNormalCdfMatchesScalar) {
+    const auto xs = grid(-37.0, 9.0, 20001);
+    const auto ys = simdApply(xs, [](Simd::vdouble x) { return Simd::normalCdf(x); });
+    for (size_t i = 0; i < xs.size(); ++i) {
+        const double ref = normalCdf(xs[i]);
+        EXPECT_LE(std::fabs(ys[i] - ref), 1e-14 * ref + 1e-300) << "x = " << xs[i];
+    }
+    EXPECT_EQ(normalCdf(0.0), 0.5);
+    EXPECT_NEAR(normalCdf(1.96), 0.97500210485177952, 1e-16);
+    EXPECT_NEAR(normalCdf(-10.0) / 7.6198530241605260e-24, 1.0, 1e-14);
+}
+
+TEST(GaussiansTest, InverseCdfRoundTrips) {
+    std::vector<double> ps;
+    for (double p = 1e-300; p < 0.01; p *= 3.7) ps.push_back(p);
+    for (double p : grid(0.001, 0.999, 9999)) ps.push_back(p);
+    for (double p = 0.01; p > 1e-15; p /= 3.7) ps.push_back(1.0 - p);
+    const auto xs = simdApply(ps, [](Simd::vdouble p) { return Simd::invNormalCdf(p); });
+    for (size_t i = 0; i < ps.size(); ++i) {
+        const double p = ps[i], x = invNormalCdf(p);
+        // relative to the probability of the tail p lies in
+        const double tail = std::min(p, 1.0 - p);
+        const double back = p < 0.5 ? normalCdf(x) : 1.0 - normalCdf(x);
+        EXPECT_LE(std::fabs(back - (p < 0.5 ? p : 1.0 - p)), 1e-14 * tail + 2e-16) << "p = " << p;
+        EXPECT_LE(std::fabs(xs[i] - x), 1e-13 * std::fabs(x) + 1e-15) << "p = " << p;
+    }
+    EXPECT_EQ(invNormalCdf(0.5), 0.0);
+    EXPECT_TRUE(std::isinf(invNormalCdf(0.0)) && invNormalCdf(0.0) < 0.0);
+}
@@ -1,4 +1,5 @@
 #include "matrix.h"
+#include <cmath>
 
 using namespace std;
 
@@ -83,7 +84,7 @@ namespace MatLib
         return make_pair(row_num, col_num);
     }
 
-    double Matrix::operator()(int a, int b){
+    double& Matrix::operator()(int a, int b){
         return p[a][b];
     }
 
@@ -211,6 +212,42 @@ namespace MatLib
         }
         cout << endl;
     }
+    bool Matrix::choleskySolve(double *b)
+    {
+        const size_t n = row_num;
+        for (size_t j = 0; j < n; j++)
+        {
+            double d = p[j][j];
+            for (size_t k = 0; k < j; k++)
+                d -= p[j][k] * p[j][k];
+            if (!(d > 0.0))
+                return false;
+            d = sqrt(d);
+            p[j][j] = d;
+            for (size_t i = j + 1; i < n; i++)
+            {
+                double s = p[i][j];
+                for (size_t k = 0; k < j; k++)
+                    s -= p[i][k] * p[j][k];
+                p[i][j] = s / d;
+            }
+        }
+        // L y = b, then L' x = y
+        for (size_t i = 0; i < n; i++)
+        {
+            for (size_t k = 0; k < i; k++)
+                b[i] -= p[i][k] * b[k];
+            b[i] /= p[i][i];
+        }
+        for (size_t i = n; i-- > 0;)
+        {
+            for (size_t k = i + 1; k < n; k++)
+                b[i] -= p[k][i] * b[k];
+            b[i] /= p[i][i];
+        }
+        return true;
+    }
+
     /// Method to calculate the Determinant of a Matrix
 
     // NOT SURE WHAT THESE ARE DOING SINCE MATRIX ISN'T DECLARED AS A TEMPLATE CLASS
@@ -34,7 +34,7 @@ namespace MatLib
         Matrix &operator+(const Matrix &m);
         Matrix &operator*=(double a);
         Matrix &operator*(double a);
-        double operator()(int a, int b);
+        double& operator()(int a, int b);
         Matrix *mmult(Matrix a, Matrix b);
         double *getRow(int i);
         double *getCol(int i);
@@ -42,6 +42,9 @@ namespace MatLib
         double sum();
         double sum(int n);
         void show() const;
+        // Solves A x = b in place for a symmetric positive definite A (lower triangle read),
+        // A is overwritten by its Cholesky factor; false, with b unchanged, if A is not positive definite
+        bool choleskySolve(double *b);
     
         static Matrix identity(const int numRows, const int numCols, double val = 1, int rowStart = 0) {
             // initialize 2d array first then convert
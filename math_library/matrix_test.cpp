@@ -16,3 +16,17 @@ TEST(MatrixTest, GetDimFailure) {
 
     EXPECT_NE(mat.get_dim(), unexpected_results);
 }
+
+TEST(MatrixTest, CholeskySolve) {
+    MatLib::Matrix mat({ { 4, 2, 0 }, { 2, 5, 1 }, { 0, 1, 3 } });
+    double b[3] = { 2, 7, 7 };
+    EXPECT_TRUE(mat.choleskySolve(b));
+    EXPECT_NEAR(b[0], 0.0, 1e-14);
+    EXPECT_NEAR(b[1], 1.0, 1e-14);
+    EXPECT_NEAR(b[2], 2.0, 1e-14);
+
+    MatLib::Matrix singular({ { 1, 1 }, { 1, 1 } });
+    double c[2] = { 1, 2 };
+    EXPECT_FALSE(singular.choleskySolve(c));
+    EXPECT_EQ(c[1], 2.0);
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <math.h>
+#include <cstdint>
+#include <cstddef>
+using namespace std;
+
+//  Philox4x32-10 counter-based random number generator
+//  Salmon, Moraes, Dror & Shaw, Parallel Random Numbers: As Easy as 1, 2, 3, SC11 (2011)
+//  The output is a pure function of (key, counter): the key is the seed,
+//  the upper half of the counter selects the substream (e.g. the path index)
+//  and the lower half the position inside it, so skip-ahead is O(1)
+//  and any path can be regenerated on any thread or machine
+
+class Philox
+{
+    static constexpr uint32_t M0 = 0xD2511F53;
+    static constexpr uint32_t M1 = 0xCD9E8D57;
+    static constexpr uint32_t W0 = 0x9E3779B9;
+    static constexpr uint32_t W1 = 0xBB67AE85;
+
+    uint32_t myKey[2];
+    uint32_t myCounter[4];
+
+    //  Current output block and how much of it was consumed
+    uint32_t myBlock[4];
+    size_t myUsed = 4;
+
+    static void round(uint32_t* ctr, const uint32_t* key)
+    {
+        const uint64_t p0 = uint64_t(M0) * ctr[0];
+        const uint64_t p1 = uint64_t(M1) * ctr[2];
+        const uint32_t c0 = uint32_t(p1 >> 32) ^ ctr[1] ^ key[0];
+        const uint32_t c2 = uint32_t(p0 >> 32) ^ ctr[3] ^ key[1];
+        ctr[0] = c0;
+        ctr[1] = uint32_t(p1);
+        ctr[2] = c2;
+        ctr[3] = uint32_t(p0);
+    }
+
+    void incrementCounter(const uint64_t n = 1)
+    {
+        uint64_t pos = position() + n;
+        myCounter[0] = uint32_t(pos);
+        myCounter[1] = uint32_t(pos >> 32);
+    }
+
+public:
+
+    //  The bijection itself: 10 rounds on (counter, key)
+    static void block(const uint32_t* ctr, const uint32_t* key, uint32_t* out)
+    {
+        uint32_t c[4] = { ctr[0], ctr[1], ctr[2], ctr[3] };
+        uint32_t k[2] = { key[0], key[1] };
+        for (int r = 0; r < 9; ++r)
+        {
+            round(c, k);
+            k[0] += W0;
+            k[1] += W1;
+        }
+        round(c, k);
+        out[0] = c[0]; out[1] = c[1]; out[2] = c[2]; out[3] = c[3];
+    }
+
+    explicit Philox(const uint64_t seed = 0, const uint64_t stream = 0)
+    {
+        myKey[0] = uint32_t(seed);
+        myKey[1] = uint32_t(seed >> 32);
+        setStream(stream);
+    }
+
+    //  Jump to the start of a substream
+    void setStream(const uint64_t stream)
+    {
+        myCounter[0] = myCounter[1] = 0;
+        myCounter[2] = uint32_t(stream);
+        myCounter[3] = uint32_t(stream >> 32);
+        myUsed = 4;
+    }
+
+    uint64_t stream() const
+    {
+        return uint64_t(myCounter[2]) | (uint64_t(myCounter[3]) << 32);
+    }
+
+    //  Index of the next block in the current substream
+    uint64_t position() const
+    {
+        return uint64_t(myCounter[0]) | (uint64_t(myCounter[1]) << 32);
+    }
+
+    //  Skip n blocks (4 x 32 bits each) in O(1)
+    void discard(const uint64_t n)
+    {
+        incrementCounter(n);
+        myUsed = 4;
+    }
+
+    //  Next 4 x 32 bits
+    void nextBlock(uint32_t* out)
+    {
+        block(myCounter, myKey, out);
+        incrementCounter();
+    }
+
+    //  64-bit output, so the generator can be used like std::mt19937_64
+    using result_type = uint64_t;
+    static constexpr uint64_t min() { return 0; }
+    static constexpr uint64_t max() { return ~uint64_t(0); }
+
+    uint64_t operator()()
+    {
+        if (myUsed == 4)
+        {
+            nextBlock(myBlock);
+            myUsed = 0;
+        }
+        const uint64_t x = uint64_t(myBlock[myUsed]) | (uint64_t(myBlock[myUsed + 1]) << 32);
+        myUsed += 2;
+        return x;
+    }
+
+    //  53-bit uniform in the open interval (0, 1)
+    static double toUniform(const uint64_t x)
+    {
+        return ((x >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+    }
+
+    double nextUniform()
+    {
+        return toUniform((*this)());
+    }
+
+    void fillUniforms(double* u, const size_t n)
+    {
+        for (size_t i = 0; i < n; ++i) u[i] = nextUniform();
+    }
+
+    //  n independent standard Gaussians, Box-Muller on both outputs of each block
+    //  Starts on a fresh block and consumes ceil(n / 2) blocks
+    void fillGaussians(double* z, const size_t n)
+    {
+        static const double twoPi = 8.0 * atan(1.0);
+        uint32_t b[4];
+        myUsed = 4;
+        for (size_t i = 0; i < n; i += 2)
+        {
+            nextBlock(b);
+            const double u1 = toUniform(uint64_t(b[0]) | (uint64_t(b[1]) << 32));
+            const double u2 = toUniform(uint64_t(b[2]) | (uint64_t(b[3]) << 32));
+            const double r = sqrt(-2.0 * log(u1));
+            z[i] = r * cos(twoPi * u2);
+            if (i + 1 < n) z[i + 1] = r * sin(twoPi * u2);
+        }
+    }
+};
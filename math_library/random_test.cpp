@@ -0,0 +1,74 @@
+#include <gtest/gtest.h>
+#include <vector>
+#include "philox.h"
+#include "sobol.h"
+
+// Known answers from the Random123 distribution (kat_vectors)
+TEST(PhiloxTest, KnownAnswers) {
+    uint32_t out[4];
+
+    uint32_t ctr0[4] = { 0, 0, 0, 0 }, key0[2] = { 0, 0 };
+    Philox::block(ctr0, key0, out);
+    EXPECT_EQ(out[0], 0x6627e8d5u);
+    EXPECT_EQ(out[1], 0xe169c58du);
+    EXPECT_EQ(out[2], 0xbc57ac4cu);
+    EXPECT_EQ(out[3], 0x9b00dbd8u);
+
+    uint32_t ctr1[4] = { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 }, key1[2] = { 0xa4093822, 0x299f31d0 };
+    Philox::block(ctr1, key1, out);
+    EXPECT_EQ(out[0], 0xd16cfe09u);
+    EXPECT_EQ(out[1], 0x94fdccebu);
+    EXPECT_EQ(out[2], 0x5001e420u);
+    EXPECT_EQ(out[3], 0x24126ea1u);
+}
+
+TEST(PhiloxTest, SkipAheadMatchesSequentialDraws) {
+    Philox sequential(7, 3), skipped(7, 3);
+    for (int i = 0; i < 1000; ++i) sequential();
+    skipped.discard(500);
+    EXPECT_EQ(sequential(), skipped());
+}
+
+TEST(PhiloxTest, SubstreamsAreReproducible) {
+    std::vector<double> a(101), b(101), c(101);
+    Philox gen(42);
+    gen.setStream(12345);
+    gen.fillGaussians(a.data(), a.size());
+    Philox(42, 12345).fillGaussians(b.data(), b.size());
+    Philox(42, 12346).fillGaussians(c.data(), c.size());
+    EXPECT_EQ(a, b);
+    EXPECT_NE(a, c);
+}
+
+// Points with the digital shift removed against the sequence of Joe and Kuo's direction numbers
+// (new-joe-kuo-6.21201, as in boost::random::sobol), in Gray code order
+TEST(SobolTest, JoeKuoDirectionNumbers) {
+    Sobol sobol(1111);
+    std::vector<double> first(1111), u(1111);
+    sobol.next(first.data());
+    auto unshifted = [&](size_t d) {
+        return (uint32_t(u[d] * 4294967296.0) ^ uint32_t(first[d] * 4294967296.0)) / 4294967296.0;
+    };
+    const double expected[4][4] = {
+        { 0.5, 0.5, 0.5, 0.5 }, { 0.75, 0.25, 0.25, 0.25 }, { 0.25, 0.75, 0.75, 0.75 }, { 0.375, 0.375, 0.625, 0.875 } };
+    for (int n = 1; n <= 16; ++n) {
+        sobol.next(u.data());
+        if (n <= 4) {
+            for (size_t d = 0; d < 4; ++d) EXPECT_EQ(unshifted(d), expected[n - 1][d]);
+        }
+        if (n == 5) {
+            EXPECT_EQ(unshifted(500), 0.875);
+            EXPECT_EQ(unshifted(1110), 0.375);
+        }
+        if (n == 16) {
+            EXPECT_EQ(unshifted(500), 0.46875);
+            EXPECT_EQ(unshifted(1110), 0.40625);
+        }
+    }
+
+    // past the table: dimensions of degree-14 polynomials, random initial numbers
+    Sobol wide(Sobol::maxDim());
+    std::vector<double> v(Sobol::maxDim());
+    EXPECT_EQ(Sobol::maxDim(), 1867u);
+    EXPECT_NO_THROW(wide.next(v.data()));
+}
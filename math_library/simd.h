@@ -0,0 +1,406 @@
+#pragma once
+
+//  Thin SIMD layer for the batch kernels
+//  The register width is picked at compile time from the target flags:
+//      AVX-512F (-mavx512f, /arch:AVX512): 8 doubles
+//      AVX2 + FMA (-mavx2 -mfma, /arch:AVX2): 4 doubles
+//      otherwise a scalar fallback with the same interface
+//  Kernels are written once against vdouble / vuint64 and the math functions below
+//  (polynomial exp, log, sincos) so every width computes the same approximations
+
+#include <math.h>
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <vector>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+namespace Simd
+{
+    //  Cache line aligned storage for SoA buffers
+
+    constexpr size_t alignment = 64;
+
+    template <class T>
+    struct AlignedAllocator
+    {
+        using value_type = T;
+        AlignedAllocator() = default;
+        template <class U> AlignedAllocator(const AlignedAllocator<U>&) {}
+
+        T* allocate(const size_t n)
+        {
+            return static_cast<T*>(::operator new(n * sizeof(T), align_val_t(alignment)));
+        }
+        void deallocate(T* p, const size_t)
+        {
+            ::operator delete(p, align_val_t(alignment));
+        }
+
+        template <class U> bool operator==(const AlignedAllocator<U>&) const { return true; }
+        template <class U> bool operator!=(const AlignedAllocator<U>&) const { return false; }
+    };
+
+    template <class T>
+    using aligned_vector = vector<T, AlignedAllocator<T>>;
+
+    //  Registers
+
+#if defined(__AVX512F__)
+
+    constexpr size_t width = 8;
+
+    struct vdouble { __m512d v; };
+    struct vuint64 { __m512i v; };
+    struct vmask { __mmask8 m; };
+
+    inline vdouble set1(const double x) { return { _mm512_set1_pd(x) }; }
+    inline vdouble load(const double* p) { return { _mm512_load_pd(p) }; }
+    inline vdouble loadu(const double* p) { return { _mm512_loadu_pd(p) }; }
+    inline void store(double* p, const vdouble a) { _mm512_store_pd(p, a.v); }
+    inline void storeu(double* p, const vdouble a) { _mm512_storeu_pd(p, a.v); }
+
+    inline vdouble operator+(const vdouble a, const vdouble b) { return { _mm512_add_pd(a.v, b.v) }; }
+    inline vdouble operator-(const vdouble a, const vdouble b) { return { _mm512_sub_pd(a.v, b.v) }; }
+    inline vdouble operator*(const vdouble a, const vdouble b) { return { _mm512_mul_pd(a.v, b.v) }; }
+    inline vdouble operator/(const vdouble a, const vdouble b) { return { _mm512_div_pd(a.v, b.v) }; }
+    inline vdouble fma(const vdouble a, const vdouble b, const vdouble c) { return { _mm512_fmadd_pd(a.v, b.v, c.v) }; }
+    inline vdouble sqrt(const vdouble a) { return { _mm512_sqrt_pd(a.v) }; }
+    inline vdouble min(const vdouble a, const vdouble b) { return { _mm512_min_pd(a.v, b.v) }; }
+    inline vdouble max(const vdouble a, const vdouble b) { return { _mm512_max_pd(a.v, b.v) }; }
+    inline vdouble round(const vdouble a) { return { _mm512_roundscale_pd(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC) }; }
+
+    inline vmask operator<(const vdouble a, const vdouble b) { return { _mm512_cmp_pd_mask(a.v, b.v, _CMP_LT_OQ) }; }
+    inline vmask operator>(const vdouble a, const vdouble b) { return { _mm512_cmp_pd_mask(a.v, b.v, _CMP_GT_OQ) }; }
+    inline vmask operator==(const vdouble a, const vdouble b) { return { _mm512_cmp_pd_mask(a.v, b.v, _CMP_EQ_OQ) }; }
+    inline vmask operator&&(const vmask a, const vmask b) { return { __mmask8(a.m & b.m) }; }
+    inline vmask operator||(const vmask a, const vmask b) { return { __mmask8(a.m | b.m) }; }
+    inline bool any(const vmask a) { return a.m != 0; }
+    //  m ? a : b, lane by lane
+    inline vdouble select(const vmask m, const vdouble a, const vdouble b) { return { _mm512_mask_blend_pd(m.m, b.v, a.v) }; }
+
+    inline vuint64 set1(const uint64_t x) { return { _mm512_set1_epi64(int64_t(x)) }; }
+    inline vuint64 operator+(const vuint64 a, const vuint64 b) { return { _mm512_add_epi64(a.v, b.v) }; }
+    inline vuint64 operator^(const vuint64 a, const vuint64 b) { return { _mm512_xor_si512(a.v, b.v) }; }
+    inline vuint64 operator&(const vuint64 a, const vuint64 b) { return { _mm512_and_si512(a.v, b.v) }; }
+    inline vuint64 operator|(const vuint64 a, const vuint64 b) { return { _mm512_or_si512(a.v, b.v) }; }
+    template <int n> inline vuint64 shiftRight(const vuint64 a) { return { _mm512_srli_epi64(a.v, n) }; }
+    template <int n> inline vuint64 shiftLeft(const vuint64 a) { return { _mm512_slli_epi64(a.v, n) }; }
+    //  Full 64-bit products of the low 32 bits of each lane
+    inline vuint64 mul32(const vuint64 a, const vuint64 b) { return { _mm512_mul_epu32(a.v, b.v) }; }
+    inline vuint64 asUint(const vdouble a) { return { _mm512_castpd_si512(a.v) }; }
+    inline vdouble asDouble(const vuint64 a) { return { _mm512_castsi512_pd(a.v) }; }
+    inline vuint64 loadu(const uint64_t* p) { return { _mm512_loadu_si512(p) }; }
+
+#elif defined(__AVX2__)
+
+    constexpr size_t width = 4;
+
+    struct vdouble { __m256d v; };
+    struct vuint64 { __m256i v; };
+    struct vmask { __m256d m; };
+
+    inline vdouble set1(const double x) { return { _mm256_set1_pd(x) }; }
+    inline vdouble load(const double* p) { return { _mm256_load_pd(p) }; }
+    inline vdouble loadu(const double* p) { return { _mm256_loadu_pd(p) }; }
+    inline void store(double* p, const vdouble a) { _mm256_store_pd(p, a.v); }
+    inline void storeu(double* p, const vdouble a) { _mm256_storeu_pd(p, a.v); }
+
+    inline vdouble operator+(const vdouble a, const vdouble b) { return { _mm256_add_pd(a.v, b.v) }; }
+    inline vdouble operator-(const vdouble a, const vdouble b) { return { _mm256_sub_pd(a.v, b.v) }; }
+    inline vdouble operator*(const vdouble a, const vdouble b) { return { _mm256_mul_pd(a.v, b.v) }; }
+    inline vdouble operator/(const vdouble a, const vdouble b) { return { _mm256_div_pd(a.v, b.v) }; }
+#if defined(__FMA__)
+    inline vdouble fma(const vdouble a, const vdouble b, const vdouble c) { return { _mm256_fmadd_pd(a.v, b.v, c.v) }; }
+#else
+    inline vdouble fma(const vdouble a, const vdouble b, const vdouble c) { return { _mm256_add_pd(_mm256_mul_pd(a.v, b.v), c.v) }; }
+#endif
+    inline vdouble sqrt(const vdouble a) { return { _mm256_sqrt_pd(a.v) }; }
+    inline vdouble min(const vdouble a, const vdouble b) { return { _mm256_min_pd(a.v, b.v) }; }
+    inline vdouble max(const vdouble a, const vdouble b) { return { _mm256_max_pd(a.v, b.v) }; }
+    inline vdouble round(const vdouble a) { return { _mm256_round_pd(a.v, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC) }; }
+
+    inline vmask operator<(const vdouble a, const vdouble b) { return { _mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ) }; }
+    inline vmask operator>(const vdouble a, const vdouble b) { return { _mm256_cmp_pd(a.v, b.v, _CMP_GT_OQ) }; }
+    inline vmask operator==(const vdouble a, const vdouble b) { return { _mm256_cmp_pd(a.v, b.v, _CMP_EQ_OQ) }; }
+    inline vmask operator&&(const vmask a, const vmask b) { return { _mm256_and_pd(a.m, b.m) }; }
+    inline vmask operator||(const vmask a, const vmask b) { return { _mm256_or_pd(a.m, b.m) }; }
+    inline bool any(const vmask a) { return _mm256_movemask_pd(a.m) != 0; }
+    inline vdouble select(const vmask m, const vdouble a, const vdouble b) { return { _mm256_blendv_pd(b.v, a.v, m.m) }; }
+
+    inline vuint64 set1(const uint64_t x) { return { _mm256_set1_epi64x(int64_t(x)) }; }
+    inline vuint64 operator+(const vuint64 a, const vuint64 b) { return { _mm256_add_epi64(a.v, b.v) }; }
+    inline vuint64 operator^(const vuint64 a, const vuint64 b) { return { _mm256_xor_si256(a.v, b.v) }; }
+    inline vuint64 operator&(const vuint64 a, const vuint64 b) { return { _mm256_and_si256(a.v, b.v) }; }
+    inline vuint64 operator|(const vuint64 a, const vuint64 b) { return { _mm256_or_si256(a.v, b.v) }; }
+    template <int n> inline vuint64 shiftRight(const vuint64 a) { return { _mm256_srli_epi64(a.v, n) }; }
+    template <int n> inline vuint64 shiftLeft(const vuint64 a) { return { _mm256_slli_epi64(a.v, n) }; }
+    inline vuint64 mul32(const vuint64 a, const vuint64 b) { return { _mm256_mul_epu32(a.v, b.v) }; }
+    inline vuint64 asUint(const vdouble a) { return { _mm256_castpd_si256(a.v) }; }
+    inline vdouble asDouble(const vuint64 a) { return { _mm256_castsi256_pd(a.v) }; }
+    inline vuint64 loadu(const uint64_t* p) { return { _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)) }; }
+
+#else
+
+    constexpr size_t width = 1;
+
+    struct vdouble { double v; };
+    struct vuint64 { uint64_t v; };
+    struct vmask { bool m; };
+
+    inline vdouble set1(const double x) { return { x }; }
+    inline vdouble load(const double* p) { return { *p }; }
+    inline vdouble loadu(const double* p) { return { *p }; }
+    inline void store(double* p, const vdouble a) { *p = a.v; }
+    inline void storeu(double* p, const vdouble a) { *p = a.v; }
+
+    inline vdouble operator+(const vdouble a, const vdouble b) { return { a.v + b.v }; }
+    inline vdouble operator-(const vdouble a, const vdouble b) { return { a.v - b.v }; }
+    inline vdouble operator*(const vdouble a, const vdouble b) { return { a.v * b.v }; }
+    inline vdouble operator/(const vdouble a, const vdouble b) { return { a.v / b.v }; }
+    inline vdouble fma(const vdouble a, const vdouble b, const vdouble c) { return { a.v * b.v + c.v }; }
+    inline vdouble sqrt(const vdouble a) { return { ::sqrt(a.v) }; }
+    inline vdouble min(const vdouble a, const vdouble b) { return { a.v < b.v ? a.v : b.v }; }
+    inline vdouble max(const vdouble a, const vdouble b) { return { a.v > b.v ? a.v : b.v }; }
+    inline vdouble round(const vdouble a) { return { nearbyint(a.v) }; }
+
+    inline vmask operator<(const vdouble a, const vdouble b) { return { a.v < b.v }; }
+    inline vmask operator>(const vdouble a, const vdouble b) { return { a.v > b.v }; }
+    inline vmask operator==(const vdouble a, const vdouble b) { return { a.v == b.v }; }
+    inline vmask operator&&(const vmask a, const vmask b) { return { a.m && b.m }; }
+    inline vmask operator||(const vmask a, const vmask b) { return { a.m || b.m }; }
+    inline bool any(const vmask a) { return a.m; }
+    inline vdouble select(const vmask m, const vdouble a, const vdouble b) { return m.m ? a : b; }
+
+    inline vuint64 set1(const uint64_t x) { return { x }; }
+    inline vuint64 operator+(const vuint64 a, const vuint64 b) { return { a.v + b.v }; }
+    inline vuint64 operator^(const vuint64 a, const vuint64 b) { return { a.v ^ b.v }; }
+    inline vuint64 operator&(const vuint64 a, const vuint64 b) { return { a.v & b.v }; }
+    inline vuint64 operator|(const vuint64 a, const vuint64 b) { return { a.v | b.v }; }
+    template <int n> inline vuint64 shiftRight(const vuint64 a) { return { a.v >> n }; }
+    template <int n> inline vuint64 shiftLeft(const vuint64 a) { return { a.v << n }; }
+    inline vuint64 mul32(const vuint64 a, const vuint64 b) { return { (a.v & 0xffffffffu) * (b.v & 0xffffffffu) }; }
+    inline vuint64 asUint(const vdouble a) { uint64_t u; memcpy(&u, &a.v, 8); return { u }; }
+    inline vdouble asDouble(const vuint64 a) { double d; memcpy(&d, &a.v, 8); return { d }; }
+    inline vuint64 loadu(const uint64_t* p) { return { *p }; }
+
+#endif
+
+    //  Width independent helpers
+
+    inline vdouble operator-(const vdouble a) { return set1(0.0) - a; }
+    inline vdouble abs(const vdouble a) { return asDouble(asUint(a) & set1(uint64_t(0x7fffffffffffffff))); }
+
+    //  Horner evaluation of c[0] + c[1] x + ... + c[N-1] x^(N-1)
+    template <size_t N>
+    inline vdouble polynomial(const vdouble x, const double (&c)[N])
+    {
+        vdouble r = set1(c[N - 1]);
+        for (size_t i = N - 1; i > 0; --i) r = fma(r, x, set1(c[i - 1]));
+        return r;
+    }
+
+    //  2^n for integer valued n in [-1022, 1023]
+    inline vdouble pow2n(const vdouble n)
+    {
+        const vuint64 bits = asUint(n + set1(6755399441055744.0));      //  1.5 * 2^52: n lands in the low bits
+        return asDouble(shiftLeft<52>(bits + set1(uint64_t(1023))));
+    }
+
+    //  ln 2 split so that n * ln2Hi is exact (Cody & Waite)
+    constexpr double ln2Hi = 6.93145751953125E-1;
+    constexpr double ln2Lo = 1.42860682030941723212E-6;
+
+    //  exp, relative error ~2e-16, argument clamped to [-708, 709]
+    inline vdouble exp(vdouble x)
+    {
+        static constexpr double c[14] = {
+            1.0, 1.0, 1.0 / 2, 1.0 / 6, 1.0 / 24, 1.0 / 120, 1.0 / 720, 1.0 / 5040,
+            1.0 / 40320, 1.0 / 362880, 1.0 / 3628800, 1.0 / 39916800, 1.0 / 479001600, 1.0 / 6227020800 };
+        x = max(min(x, set1(709.0)), set1(-708.0));
+        const vdouble n = round(x * set1(1.4426950408889634));
+        //  |r| <= ln2 / 2
+        const vdouble r = fma(n, set1(-ln2Lo), fma(n, set1(-ln2Hi), x));
+        return polynomial(r, c) * pow2n(n);
+    }
+
+    //  log of positive normal numbers, relative error ~2e-16
+    //  x = 2^e m with m in [sqrt(1/2), sqrt(2)), log m = 2 atanh((m - 1) / (m + 1))
+    inline vdouble log(const vdouble x)
+    {
+        static constexpr double c[11] = {
+            2.0, 2.0 / 3, 2.0 / 5, 2.0 / 7, 2.0 / 9, 2.0 / 11, 2.0 / 13, 2.0 / 15, 2.0 / 17, 2.0 / 19, 2.0 / 21 };
+        const vuint64 bits = asUint(x);
+        vdouble m = asDouble((bits & set1(uint64_t(0x000fffffffffffff))) | set1(uint64_t(0x3ff0000000000000)));
+        //  Biased exponent as a double
+        vdouble e = asDouble(shiftRight<52>(bits) | set1(uint64_t(0x4330000000000000))) - set1(4503599627370496.0 + 1023.0);
+        const vmask big = m > set1(1.4142135623730951);
+        m = select(big, m * set1(0.5), m);
+        e = select(big, e + set1(1.0), e);
+        const vdouble f = (m - set1(1.0)) / (m + set1(1.0));
+        const vdouble f2 = f * f;
+        const vdouble logm = f * polynomial(f2, c);
+        return fma(e, set1(ln2Hi), fma(e, set1(ln2Lo), logm));
+    }
+
+    //  cos(2 pi u) and sin(2 pi u), absolute error ~1e-15
+    inline void sincos2pi(const vdouble u, vdouble& s, vdouble& c)
+    {
+        static constexpr double cs[9] = {
+            1.0, -1.0 / 6, 1.0 / 120, -1.0 / 5040, 1.0 / 362880, -1.0 / 39916800,
+            1.0 / 6227020800, -1.0 / 1307674368000, 1.0 / 355687428096000 };
+        static constexpr double cc[10] = {
+            1.0, -1.0 / 2, 1.0 / 24, -1.0 / 720, 1.0 / 40320, -1.0 / 3628800,
+            1.0 / 479001600, -1.0 / 87178291200, 1.0 / 20922789888000, -1.0 / 6402373705728000 };
+
+        //  Reduce to t in [-1/2, 1/2], then quadrant q and phi in [-pi/4, pi/4]
+        const vdouble t = u - round(u);
+        vdouble q = round(t * set1(4.0));
+        const vdouble phi = (t - q * set1(0.25)) * set1(6.283185307179586);
+        const vdouble phi2 = phi * phi;
+        const vdouble sp = phi * polynomial(phi2, cs);
+        const vdouble cp = polynomial(phi2, cc);
+
+        q = select(q < set1(0.0), q + set1(4.0), q);
+        const vmask q1 = q == set1(1.0), q2 = q == set1(2.0), q3 = q == set1(3.0);
+        c = select(q1, -sp, select(q2, -cp, select(q3, sp, cp)));
+        s = select(q1, cp, select(q2, -sp, select(q3, -cp, sp)));
+    }
+
+    //  Standard normal density
+    inline vdouble normalDens(const vdouble x)
+    {
+        return exp(set1(-0.5) * x * x) * set1(0.3989422804014327);
+    }
+
+    //  Complementary error function, W. J. Cody's rational approximations (Math. Comp. 1969),
+    //  relative error ~1e-16 over the three ranges |x| <= 0.46875, <= 4 and beyond,
+    //  all evaluated and blended so there is no branch
+    inline vdouble erfc(const vdouble x)
+    {
+        static constexpr double a[5] = { 3.16112374387056560e00, 1.13864154151050156e02, 3.77485237685302021e02,
+            3.20937758913846947e03, 1.85777706184603153e-1 };
+        static constexpr double b[4] = { 2.36012909523441209e01, 2.44024637934444173e02, 1.28261652607737228e03,
+            2.84423683343917062e03 };
+        static constexpr double c[9] = { 5.64188496988670089e-1, 8.88314979438837594e00, 6.61191906371416295e01,
+            2.98635138197400131e02, 8.81952221241769090e02, 1.71204761263407058e03, 2.05107837782607147e03,
+            1.23033935479799725e03, 2.15311535474403846e-8 };
+        static constexpr double d[8] = { 1.57449261107098347e01, 1.17693950891312499e02, 5.37181101862009858e02,
+            1.62138957456669019e03, 3.29079923573345963e03, 4.36261909014324716e03, 3.43936767414372164e03,
+            1.23033935480374942e03 };
+        static constexpr double p[6] = { 3.05326634961232344e-1, 3.60344899949804439e-1, 1.25781726111229246e-1,
+            1.60837851487422766e-2, 6.58749161529837803e-4, 1.63153871373020978e-2 };
+        static constexpr double q[5] = { 2.56852019228982242e00, 1.87295284992346725e00, 5.27905102951428412e-1,
+            6.05183413124413191e-2, 2.33520497626869185e-3 };
+
+        const vdouble y = abs(x), ysq = y * y;
+
+        //  |x| <= 0.46875: erf x = x P(x^2) / Q(x^2)
+        vdouble num = set1(a[4]) * ysq, den = ysq;
+        for (int i = 0; i < 3; ++i)
+        {
+            num = (num + set1(a[i])) * ysq;
+            den = (den + set1(b[i])) * ysq;
+        }
+        const vdouble small = set1(1.0) - x * (num + set1(a[3])) / (den + set1(b[3]));
+
+        //  0.46875 < |x| <= 4: erfc y = exp(-y^2) P(y) / Q(y)
+        num = set1(c[8]) * y;
+        den = y;
+        for (int i = 0; i < 7; ++i)
+        {
+            num = (num + set1(c[i])) * y;
+            den = (den + set1(d[i])) * y;
+        }
+        const vdouble mid = (num + set1(c[7])) / (den + set1(d[7]));
+
+        //  |x| > 4: erfc y = exp(-y^2) / y (1 / sqrt(pi) - P(1/y^2) / Q(1/y^2) / y^2)
+        const vdouble z = set1(1.0) / ysq;
+        num = set1(p[5]) * z;
+        den = z;
+        for (int i = 0; i < 4; ++i)
+        {
+            num = (num + set1(p[i])) * z;
+            den = (den + set1(q[i])) * z;
+        }
+        const vdouble large = (set1(0.56418958354775628695) - z * (num + set1(p[4])) / (den + set1(q[4]))) / y;
+
+        //  exp(-y^2) as exp(-s^2) exp(-(y - s)(y + s)) with s = y rounded to 1/16, s^2 exact
+        const vdouble s = round(y * set1(16.0)) * set1(0.0625);
+        const vdouble gauss = exp(-(s * s)) * exp(-((y - s) * (y + s)));
+        vdouble r = gauss * select(y > set1(4.0), large, mid);
+        r = select(y > set1(26.6), set1(0.0), r);
+        r = select(x < set1(0.0), set1(2.0) - r, r);
+        return select(y > set1(0.46875), r, small);
+    }
+
+    //  Standard normal CDF, N(x) = erfc(-x / sqrt(2)) / 2, absolute and left-tail relative error ~1e-15
+    inline vdouble normalCdf(const vdouble x)
+    {
+        return set1(0.5) * erfc(x * set1(-0.70710678118654752440));
+    }
+
+    //  Inverse normal CDF: Acklam's rational approximation on the central and tail ranges, blended,
+    //  then one Halley step on normalCdf, ~1e-15 like invNormalCdf in gaussians.h
+    inline vdouble invNormalCdf(const vdouble p)
+    {
+        //  Ascending powers
+        static constexpr double a[6] = { 2.506628277459239e+00, -3.066479806614716e+01, 1.383577518672690e+02,
+            -2.759285104469687e+02, 2.209460984245205e+02, -3.969683028665376e+01 };
+        static constexpr double b[6] = { 1.0, -1.328068155288572e+01, 6.680131188771972e+01,
+            -1.556989798598866e+02, 1.615858368580409e+02, -5.447609879822406e+01 };
+        static constexpr double c[6] = { 2.938163982698783e+00, 4.374664141464968e+00, -2.549732539343734e+00,
+            -2.400758277161838e+00, -3.223964580411365e-01, -7.784894002430293e-03 };
+        static constexpr double d[5] = { 1.0, 3.754408661907416e+00, 2.445134137142996e+00,
+            3.224671290700398e-01, 7.784695709041462e-03 };
+
+        const vdouble half = set1(0.5), one = set1(1.0);
+        const vdouble q = p - half, r = q * q;
+        const vdouble central = q * polynomial(r, a) / polynomial(r, b);
+        const vdouble t = sqrt(set1(-2.0) * log(min(p, one - p)));
+        const vdouble lower = polynomial(t, c) / polynomial(t, d);
+        vdouble x = select(abs(q) > set1(0.5 - 0.02425), select(q > set1(0.0), -lower, lower), central);
+
+        const vdouble tail = normalCdf(-abs(x));
+        const vdouble e = select(x < set1(0.0), tail - p, (one - p) - tail);
+        const vdouble u = e * set1(2.50662827463100050242) * exp(half * x * x);
+        x = x - u / fma(half * x, u, one);
+
+        const vdouble inf = set1(HUGE_VAL);
+        x = select(p < set1(0.0) || p == set1(0.0), -inf, x);
+        return select(p > one || p == one, inf, x);
+    }
+
+    //  Uniform in (0, 1) out of the top 52 bits of a 64-bit random word
+    inline vdouble toUniform(const vuint64 x)
+    {
+        const vdouble oneToTwo = asDouble(shiftRight<12>(x) | set1(uint64_t(0x3ff0000000000000)));
+        return oneToTwo - set1(1.0 - 1.0 / 9007199254740992.0);
+    }
+
+    //  Philox4x32-10 on width counters at once, one 32-bit word per 64-bit lane
+    //  Same bijection as Philox::block
+    inline void philox(vuint64& c0, vuint64& c1, vuint64& c2, vuint64& c3, uint32_t k0, uint32_t k1)
+    {
+        const vuint64 m0 = set1(uint64_t(0xD2511F53)), m1 = set1(uint64_t(0xCD9E8D57));
+        const vuint64 low = set1(uint64_t(0xffffffff));
+        for (int r = 0; r < 10; ++r)
+        {
+            const vuint64 p0 = mul32(m0, c0);
+            const vuint64 p1 = mul32(m1, c2);
+            c0 = shiftRight<32>(p1) ^ c1 ^ set1(uint64_t(k0));
+            c1 = p1 & low;
+            c2 = shiftRight<32>(p0) ^ c3 ^ set1(uint64_t(k1));
+            c3 = p0 & low;
+            k0 += 0x9E3779B9;
+            k1 += 0xBB67AE85;
+        }
+    }
+}
@@ -0,0 +1,197 @@
+#pragma once
+
+#include <math.h>
+#include <cstdint>
+#include <vector>
+#include <stdexcept>
+#include "gaussians.h"
+#include "philox.h"
+#include "sobol_directions.h"
+using namespace std;
+
+//  Sobol quasi-random sequence, Gray code construction (Antonov & Saleev, 1979)
+//  See Glasserman, Monte Carlo Methods in Financial Engineering, 5.2.3
+//  Dimension d uses the d-th primitive polynomial over GF(2), in order of degree,
+//  so all polynomials up to degree 14 give 1867 dimensions
+//  The initial direction numbers of the first 1111 dimensions are those of Joe and Kuo (see sobol_directions.h),
+//  chosen for good two-dimensional projections; past them they are drawn once from a fixed Philox stream
+//  (odd m_k < 2^k), the regularity breaking initialisation of Jaeckel, Monte Carlo Methods in Finance, 8.3
+//  A random digital shift keyed by the seed makes every point usable (no zero coordinate)
+//  and gives independent randomised replications for different seeds
+
+class Sobol
+{
+    static constexpr size_t numBits = 32;
+    static constexpr unsigned maxDegree = 14;
+
+    //  Primitive polynomials: degree and the inner coefficients a_1..a_{s-1} as bits
+    struct Polynomial
+    {
+        unsigned degree;
+        uint32_t coefficients;
+    };
+
+    //  x^e mod p over GF(2), p given with its leading term
+    static uint32_t powMod(uint64_t e, const uint32_t p, const unsigned degree)
+    {
+        uint32_t result = 1, base = 2;
+        auto mulMod = [p, degree](uint32_t a, uint32_t b)
+        {
+            uint32_t r = 0;
+            for (; b; b >>= 1)
+            {
+                if (b & 1) r ^= a;
+                a <<= 1;
+                if (a >> degree & 1) a ^= p;
+            }
+            return r;
+        };
+        if (base >> degree & 1) base ^= p;
+        for (; e; e >>= 1)
+        {
+            if (e & 1) result = mulMod(result, base);
+            base = mulMod(base, base);
+        }
+        return result;
+    }
+
+    //  p is primitive iff x has order exactly 2^s - 1 modulo p
+    static bool isPrimitive(const uint32_t p, const unsigned degree)
+    {
+        const uint64_t order = (uint64_t(1) << degree) - 1;
+        if (powMod(order, p, degree) != 1) return false;
+        uint64_t n = order;
+        for (uint64_t q = 2; q * q <= n; ++q)
+        {
+            if (n % q) continue;
+            if (powMod(order / q, p, degree) == 1) return false;
+            while (n % q == 0) n /= q;
+        }
+        return n == 1 || n == order || powMod(order / n, p, degree) != 1;
+    }
+
+    static const vector<Polynomial>& polynomials()
+    {
+        static const vector<Polynomial> polys = []()
+        {
+            vector<Polynomial> res;
+            for (unsigned s = 1; s <= maxDegree; ++s)
+            {
+                //  Leading and constant terms are always set
+                for (uint32_t inner = 0; inner < (1u << (s - 1)); ++inner)
+                {
+                    const uint32_t p = (1u << s) | (inner << 1) | 1u;
+                    if (isPrimitive(p, s)) res.push_back({ s, inner });
+                }
+            }
+            return res;
+        }();
+        return polys;
+    }
+
+    //  Direction numbers v[d * numBits + k], shared by all instances
+    static const vector<uint32_t>& directions()
+    {
+        static const vector<uint32_t> dirs = []()
+        {
+            const auto& polys = polynomials();
+            const size_t dims = polys.size() + 1;
+            vector<uint32_t> v(dims * numBits);
+
+            //  First dimension: van der Corput
+            for (size_t k = 0; k < numBits; ++k) v[k] = 1u << (numBits - 1 - k);
+
+            Philox gen(0x50b01);
+            const uint16_t* table = SobolJoeKuo::initial;
+            uint32_t m[numBits];
+            for (size_t d = 1; d < dims; ++d)
+            {
+                const unsigned s = polys[d - 1].degree;
+                const uint32_t a = polys[d - 1].coefficients;
+                for (unsigned k = 0; k < s; ++k)
+                {
+                    //  odd and below 2^(k+1)
+                    m[k] = d < SobolJoeKuo::maxDim ? *table++ : (uint32_t(gen() >> 32) & ((2u << k) - 1)) | 1u;
+                }
+                for (unsigned k = s; k < numBits; ++k)
+                {
+                    m[k] = m[k - s] ^ (m[k - s] << s);
+                    for (unsigned i = 1; i < s; ++i)
+                    {
+                        if (a >> (s - 1 - i) & 1) m[k] ^= m[k - i] << i;
+                    }
+                }
+                for (unsigned k = 0; k < numBits; ++k) v[d * numBits + k] = m[k] << (numBits - 1 - k);
+            }
+            return v;
+        }();
+        return dirs;
+    }
+
+    size_t              myDim;
+    const uint32_t*     myDirections;
+    vector<uint32_t>    myShift;
+    vector<uint32_t>    myState;
+    uint64_t            myIndex;
+
+public:
+
+    static size_t maxDim()
+    {
+        return polynomials().size() + 1;
+    }
+
+    Sobol(const size_t dim, const uint64_t seed = 0) : myDim(dim), myShift(dim), myState(dim)
+    {
+        if (dim == 0 || dim > maxDim())
+            throw runtime_error("Sobol: dimension must be between 1 and " + to_string(maxDim()));
+        myDirections = directions().data();
+        Philox gen(seed, 0x50b01);
+        for (auto& s : myShift) s = uint32_t(gen() >> 32);
+        skipTo(0);
+    }
+
+    size_t dim() const { return myDim; }
+
+    //  Index of the next point
+    uint64_t index() const { return myIndex; }
+
+    //  Jump to point n in O(numBits * dim)
+    void skipTo(const uint64_t n)
+    {
+        const uint64_t gray = n ^ (n >> 1);
+        for (size_t d = 0; d < myDim; ++d)
+        {
+            uint32_t x = 0;
+            for (size_t k = 0; k < numBits; ++k)
+            {
+                if (gray >> k & 1) x ^= myDirections[d * numBits + k];
+            }
+            myState[d] = x;
+        }
+        myIndex = n;
+    }
+
+    //  Uniforms in (0, 1) of the current point, then move to the next one
+    void next(double* u)
+    {
+        for (size_t d = 0; d < myDim; ++d)
+        {
+            u[d] = ((myState[d] ^ myShift[d]) + 0.5) / 4294967296.0;
+        }
+
+        //  Gray code: the next point flips the direction of the lowest zero bit of the index
+        uint64_t n = myIndex;
+        size_t c = 0;
+        while (n & 1) { n >>= 1; ++c; }
+        for (size_t d = 0; d < myDim; ++d) myState[d] ^= myDirections[d * numBits + c];
+        ++myIndex;
+    }
+
+    //  Standard Gaussians by inversion
+    void nextGaussians(double* z)
+    {
+        next(z);
+        for (size_t d = 0; d < myDim; ++d) z[d] = invNormalCdf(z[d]);
+    }
+};
@@ -0,0 +1,168 @@
+#pragma once
+#include <vector>
+#include "../math_library/simd.h"
+
+// Black-Scholes closed form over whole option chains
+// Inputs and outputs are structure-of-arrays, one contiguous aligned array per field,
+// and the kernel prices Simd::width options per instruction with the SIMD log, exp and normalCdf,
+// computing d1, d2, the discount factor and the densities once per option for the price and all the Greeks
+// Same conventions as EurOption::PriceByBSFormula: no dividends, rate used for drift and discounting
+
+// Chain of European options, isCall stored as +1 (call) or -1 (put)
+struct OptionChain
+{
+	Simd::aligned_vector<double> spot, strike, tenor, rate, vol, isCall;
+
+	size_t size() const { return _size; }
+
+	void push_back(double S0, double K, double T, double r, double sigma, bool call = true)
+	{
+		resize(_size + 1);
+		const size_t i = _size - 1;
+		spot[i] = S0; strike[i] = K; tenor[i] = T; rate[i] = r; vol[i] = sigma; isCall[i] = call ? 1.0 : -1.0;
+	}
+
+	// Arrays are padded to a whole number of registers with a harmless option
+	void resize(size_t n)
+	{
+		const size_t padded = (n + Simd::width - 1) / Simd::width * Simd::width;
+		for (auto* a : { &spot, &strike, &tenor, &vol, &isCall }) a->resize(padded, 1.0);
+		rate.resize(padded, 0.0);
+		_size = n;
+	}
+
+private:
+	size_t _size = 0;
+};
+
+// Prices and first-order Greeks of a chain, theta per year of calendar time (-d/dT)
+struct ChainGreeks
+{
+	Simd::aligned_vector<double> price, delta, gamma, vega, theta, rho;
+
+	void resize(size_t n)
+	{
+		const size_t padded = (n + Simd::width - 1) / Simd::width * Simd::width;
+		for (auto* a : { &price, &delta, &gamma, &vega, &theta, &rho }) a->resize(padded);
+	}
+};
+
+inline void PriceByBSFormula(const OptionChain& chain, ChainGreeks& out)
+{
+	using namespace Simd;
+	out.resize(chain.size());
+	const vdouble half = set1(0.5);
+	for (size_t i = 0; i < chain.size(); i += width)
+	{
+		const vdouble S = load(chain.spot.data() + i), K = load(chain.strike.data() + i);
+		const vdouble T = load(chain.tenor.data() + i), r = load(chain.rate.data() + i);
+		const vdouble sigma = load(chain.vol.data() + i), w = load(chain.isCall.data() + i);
+
+		const vdouble sqrtT = sqrt(T), volT = sigma * sqrtT;
+		const vdouble d1 = fma(fma(half * sigma, sigma, r), T, Simd::log(S / K)) / volT;
+		const vdouble d2 = d1 - volT;
+		const vdouble df = Simd::exp(-r * T);
+		// N(w d1), N(w d2): call or put without branching
+		const vdouble Nd1 = normalCdf(w * d1), Nd2 = normalCdf(w * d2);
+		const vdouble nd1 = normalDens(d1);
+		const vdouble Kdf = K * df;
+		const vdouble SnVol = S * nd1 * sigma;
+
+		store(out.price.data() + i, w * (S * Nd1 - Kdf * Nd2));
+		store(out.delta.data() + i, w * Nd1);
+		store(out.gamma.data() + i, nd1 / (S * volT));
+		store(out.vega.data() + i, S * nd1 * sqrtT);
+		store(out.theta.data() + i, -(SnVol * half / sqrtT) - w * r * Kdf * Nd2);
+		store(out.rho.data() + i, w * T * Kdf * Nd2);
+	}
+}
+
+// Outcome of the implied volatility inversion, per option
+enum impliedVolStatus {
+	IVConverged,		// vol reprices the option
+	IVBelowIntrinsic,	// price at or below intrinsic value, vol set to 0
+	IVAboveMaximum,		// price at or above the no-arbitrage bound (spot for a call), vol set to NaN
+	IVNotConverged		// last step above 1e-4 of the iterate, vol is the last iterate
+};
+
+// Third-order Householder steps of ImpliedVolByBSFormula, fixed so the latency is bounded
+// They converge with order four, so a last step below 1e-4 s leaves an error far under 1e-12
+constexpr int ivIterations = 3;
+
+// Implied volatilities of a chain out of prices[0..chain.size()-1], written to chain.vol
+// Works on the normalised Black price of the out-of-the-money side, x = -|log(F / K)|, s = vol sqrt(T):
+//     b(x, s) = exp(x / 2) N(x / s + s / 2) - exp(-x / 2) N(x / s - s / 2)
+// Above the inflexion point s_c = sqrt(-2x) b is concave: the guess is the Corrado-Miller rational approximation
+// (at least s_c) and the iterations run on b; below it, the guess is the deep out-of-the-money asymptote
+// s = -x / sqrt(-2 log b), raised to Corrado-Miller where that one is defined (near the money), at most s_c,
+// and the iterations run on log b
+// Branch-free across Simd::width options, ~1e-12 relative accuracy for |log(F / K)| <= 8 and 0.005 <= vol sqrt(T) <= 4
+inline void ImpliedVolByBSFormula(OptionChain& chain, const double* prices, std::vector<impliedVolStatus>& status)
+{
+	using namespace Simd;
+	const size_t n = chain.size();
+	status.resize(n);
+	const vdouble zero = set1(0.0), half = set1(0.5), one = set1(1.0);
+	alignas(alignment) double padded[width], flag[width];
+
+	for (size_t i = 0; i < n; i += width)
+	{
+		// last register: pad the prices, the padding option is ATM
+		const double* px = prices + i;
+		if (i + width > n)
+		{
+			for (size_t l = 0; l < width; l++) padded[l] = i + l < n ? prices[i + l] : 0.2;
+			px = padded;
+		}
+		const vdouble S = load(chain.spot.data() + i), K = load(chain.strike.data() + i);
+		const vdouble T = load(chain.tenor.data() + i), r = load(chain.rate.data() + i);
+		const vdouble w = load(chain.isCall.data() + i), price = loadu(px);
+
+		// normalised forward moneyness and price
+		const vdouble df = Simd::exp(-r * T);
+		const vdouble x = Simd::log(S / K) + r * T;
+		const vdouble ex = Simd::exp(half * x), emx = one / ex;
+		vdouble beta = price / (df * sqrt(S / df * K));
+		// in the money: remove the intrinsic value, parity gives the other side's price
+		beta = select(w * x > zero, beta - w * (ex - emx), beta);
+		const vdouble xo = -abs(x);
+		const vdouble Fo = select(x < zero, ex, emx), Ko = one / Fo;
+		const vmask below = beta < zero || beta == zero, above = beta > Fo || beta == Fo;
+
+		// region and initial guess
+		const vdouble sc = sqrt(set1(-2.0) * xo);
+		const vdouble bc = Fo * normalCdf(xo / sc + half * sc) - Ko * normalCdf(xo / sc - half * sc);
+		const vmask logObjective = beta < bc;
+		const vdouble a = beta - half * (Fo - Ko);
+		const vdouble disc = a * a - (Fo - Ko) * (Fo - Ko) * set1(0.3183098861837907);
+		const vdouble cm = set1(2.5066282746310002) / (Fo + Ko) * (a + sqrt(max(zero, disc)));
+		const vdouble logBeta = Simd::log(beta);
+		const vdouble asymptote = -xo / sqrt(set1(-2.0) * logBeta);
+		vdouble s = select(logObjective, min(select(disc > zero, max(asymptote, cm), asymptote), sc), max(cm, sc));
+		vdouble step = zero;
+
+		for (int k = 0; k < ivIterations; k++)
+		{
+			const vdouble d1 = xo / s + half * s, d2 = d1 - s;
+			const vdouble b = Fo * normalCdf(d1) - Ko * normalCdf(d2);
+			const vdouble bp = Fo * normalDens(d1);
+			// second and third derivatives of b in s, over the first
+			const vdouble x2s3 = xo * xo / (s * s * s);
+			const vdouble h2 = x2s3 - set1(0.25) * s;
+			const vdouble h3 = h2 * h2 - set1(3.0) * x2s3 / s - set1(0.25);
+			// same ratios for log b
+			const vdouble q = bp / b;
+			const vdouble nu = select(logObjective, (logBeta - Simd::log(b)) / q, (beta - b) / bp);
+			const vdouble H2 = select(logObjective, h2 - q, h2);
+			const vdouble H3 = select(logObjective, h3 - set1(3.0) * h2 * q + set1(2.0) * q * q, h3);
+			step = nu * fma(half * H2, nu, one) / fma(H3 * set1(1.0 / 6.0) * nu, nu, fma(H2, nu, one));
+			s = s + step;
+			s = select(s > zero, s, set1(1e-3));
+		}
+
+		store(chain.vol.data() + i, select(below, zero, select(above, set1(NAN), s / sqrt(T))));
+		store(flag, select(below, set1(double(IVBelowIntrinsic)), select(above, set1(double(IVAboveMaximum)),
+			select(abs(step) < set1(1e-4) * s, set1(double(IVConverged)), set1(double(IVNotConverged))))));
+		for (size_t l = 0; l < width && i + l < n; l++) status[i + l] = impliedVolStatus(int(flag[l]));
+	}
+}
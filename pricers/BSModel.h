@@ -1,6 +1,13 @@
 #include "../pricers/option.hpp"
 #include "model.hpp"
 #include"../market/market.hpp"
+#include "MCStatistics.h"
+#include "MCWorkspace.h"
+#include "PathStore.h"
+#include "BSPDE.h"
+#include "../math_library/AAD/AADTapePool.h"
+#include <exception>
+#include <thread>
 #pragma once
 using namespace Derivatives;
 
@@ -10,42 +17,375 @@ public:
 	Option* _option;
 	BSModel(Option* option):_option(option)
 	{
-		path_hist = vector<SamplePath>();
 		Update_Params();
 	}
-	BSModel(const BSModel& mod1) : _option(mod1._option), path_hist(mod1.path_hist) { Update_Params(); };
+	BSModel(const BSModel& mod1) : Model(mod1), _option(mod1._option), pde(mod1.pde), path_hist(mod1.path_hist) { Update_Params(); };
 
 	void GenerateSamplePath(double T, int m, SamplePath& S);
+	void GenerateSamplePath(double T, int m, SamplePath& S, const double* z);
+	template <class T>
+	static void GenerateSamplePath(const T& S0, const T& mu, const T& vol, const T& mat, int m, vector<T>& S, const double* z);
+	void GeneratePathBlock(double T, unsigned int m, unsigned long long firstPath, PathBlock& block);
 	void Update_Params();
 	void Update_Params(Referential hist);
 	void Update_Params(double mu, double sig);
 
-	// Naive Monte Carlo - expected to be slow (Compiler please carry my vectorization)
-	void CalculateMC(unsigned int iteration = 10000, unsigned int mesh = 1, double epsilon = 0.0001, bool storeSamples = false){
-		double H = 0.0, Hsq = 0.0, Heps = 0.0;
-		for (unsigned int i = 0; i < iteration; i++)
+	// Grid and scheme of CalculatePDE
+	BSPDESolver pde;
+
+	// Premium by CalculateMC, or by CalculatePDE when the option has use_MC = false (vanilla options only)
+	void Calculate(unsigned int iteration = 10000, unsigned int mesh = 1, double epsilon = 0.0001, unsigned int numThreads = 1){
+		if (_option->use_MC) CalculateMC(iteration, mesh, epsilon, false, numThreads);
+		else CalculatePDE();
+	}
+
+	// Premium, delta, gamma and theta of a vanilla payoff max(0, w (S - K)) on the first underlyer from the
+	// Black-Scholes PDE (see BSPDESolver), with early exercise when the option style is American or Bermudan
+	// (pde.exerciseDates dates); throws invalid_argument for other contracts (not an EurOption) and Asian style
+	// PricingError is 0, discretisation error is controlled by pde.spaceSteps and pde.timeSteps
+	void CalculatePDE(){
+		if (!dynamic_cast<EurOption*>(_option))
+			throw invalid_argument("BSModel::CalculatePDE: the PDE prices vanilla options (EurOption) only");
+		const optionStyle style = _option->getStyle();
+		if (style != European && style != American && style != Bermudan)
+			throw invalid_argument("BSModel::CalculatePDE: no PDE for this option style");
+		const BSPDESolver::Result result = pde.Solve(_option->underlyers.front().Price(), _option->strike, _option->tenor,
+			_option->r, drift, sigma, _option->isCall, style == American, style == Bermudan);
+		_option->setPremium(result.price);
+		PricingError = 0.0;
+		PathsUsed = 0;
+		delta = result.delta;
+		gamma = result.gamma;
+		theta = result.theta;
+	}
+
+	// Monte Carlo split into fixed chunks of paths dealt to numThreads workers
+	// Path i always draws from Philox substream (seed, i), or Sobol point i, and chunks are merged back in chunk order,
+	// so price, PricingError and delta only depend on seed and never on the thread count
+	// With QuasiRandom, PricingError is the sample standard error and overstates the QMC error
+	// With Antithetic, PricingError is the standard error of the pair averages (iteration is rounded up to even);
+	// with MomentMatching, paths of a chunk are no longer independent and it is the standard error of the chunk means
+	// VarianceReductionFactor compares it with the plain i.i.d. estimate on the same payoffs
+	// Scratch memory comes from the model's workspaces and stored samples go straight to their slot
+	// of the path store, so the per-path loop does not allocate
+	void CalculateMC(unsigned int iteration = 10000, unsigned int mesh = 1, double epsilon = 0.0001, bool storeSamples = false,
+		unsigned int numThreads = 1, randomGenerator generator = PseudoRandom, varianceReduction reduction = NoVarianceReduction){
+		RunMC(iteration, mesh, epsilon, storeSamples, numThreads, generator, reduction,
+			[this](SamplePath& S) { return _option->Payoff(S); });
+	}
+
+	// CalculateMC with the payoff bound at compile time: the model's option must be an OptionType
+	// (an option deriving from StaticPayoffOption<OptionType>), whose PayoffT is called directly,
+	// so path generation and payoff are inlined into one loop, with the same paths and results as CalculateMC
+	// CalculateMC stays the entry point for products only known at run time (DifferenceOfOptions, ...)
+	template <class OptionType>
+	void CalculateMCInline(unsigned int iteration = 10000, unsigned int mesh = 1, double epsilon = 0.0001, bool storeSamples = false,
+		unsigned int numThreads = 1, randomGenerator generator = PseudoRandom, varianceReduction reduction = NoVarianceReduction){
+		OptionType* option = dynamic_cast<OptionType*>(_option);
+		if (!option) throw invalid_argument("BSModel::CalculateMCInline: option is not of the requested type");
+		RunMC(iteration, mesh, epsilon, storeSamples, numThreads, generator, reduction,
+			[option](const SamplePath& S) { return option->PayoffT(S); });
+	}
+
+	// Simulates until PricingError reaches targetError, or maxPaths paths
+	// targetError is in price units, or in basis points of notional when notional is given
+	// Runs batches of batchChunks chunks of CalculateMC (mcChunkSize paths each) and checks the merged error after each,
+	// so PathsUsed, and the results, depend on the seed, the target and batchChunks but not on numThreads,
+	// and match CalculateMC(PathsUsed, ...) exactly
+	void CalculateMCAdaptive(double targetError, unsigned int maxPaths, unsigned int mesh = 1, double epsilon = 0.0001,
+		unsigned int numThreads = 1, randomGenerator generator = PseudoRandom, varianceReduction reduction = NoVarianceReduction,
+		double notional = 0.0, unsigned int batchChunks = 8){
+		if (notional > 0.0) targetError *= 1.0e-4 * notional;
+		if (reduction == Antithetic) maxPaths += maxPaths & 1;
+		const unsigned int maxChunks = (maxPaths + mcChunkSize - 1) / mcChunkSize;
+		batchChunks = max(1u, batchChunks);
+		vector<MCStatistics> payoffStats, bumpStats, pairStats;
+		unsigned int done = 0;
+		do
 		{
-			SamplePath path;
-			GenerateSamplePath(_option->maturity, mesh, path);
-			H = (i / (i + 1.0)) * H + _option->Payoff(path) / (i + 1.0);
-			Hsq = (i / (i + 1.0)) * Hsq + pow(_option->Payoff(path), 2.0) / (i + 1.0);
-			Rescale(path, 1.0 + epsilon);
-			Heps = (i / (i + 1.0)) * Heps + _option->Payoff(path) / (i + 1.0);
-			if (storeSamples)
-				path_hist.push_back(path);
+			const unsigned int next = min(maxChunks, done + batchChunks);
+			payoffStats.resize(next);
+			bumpStats.resize(next);
+			if (reduction == Antithetic) pairStats.resize(next);
+			SimulateChunks(done, next, maxPaths, mesh, epsilon, numThreads, generator, reduction,
+				payoffStats, bumpStats, pairStats, nullptr, 0, [this](SamplePath& S) { return _option->Payoff(S); });
+			done = next;
+			SetMCResults(payoffStats, bumpStats, epsilon, reduction, pairStats);
+		} while (done < maxChunks && !(PricingError <= targetError));
+		PathsUsed = min(maxPaths, done * mcChunkSize);
+	}
+
+	// Chunks [firstChunk, lastChunk) of an iteration-path run, dealt to numThreads workers,
+	// accumulated in the per-chunk statistics and written to store from firstStored when given
+	// payoff(path) evaluates a path: a virtual call to the option, or the inlined payoff of CalculateMCInline
+	template <class Payoff>
+	void SimulateChunks(unsigned int firstChunk, unsigned int lastChunk, unsigned int iteration, unsigned int mesh, double epsilon,
+		unsigned int numThreads, randomGenerator generator, varianceReduction reduction,
+		vector<MCStatistics>& payoffStats, vector<MCStatistics>& bumpStats, vector<MCStatistics>& pairStats,
+		PathStore* store, size_t firstStored, const Payoff& payoff){
+		numThreads = max(1u, min(numThreads, lastChunk - firstChunk));
+		PrepareWorkspaces(numThreads);
+
+		auto worker = [&](unsigned int t) {
+			MCWorkspace& ws = workspaces[t];
+			ws.Prepare(mesh);
+			if (generator == QuasiRandom) ws.PrepareQuasiRandom(mesh, seed);
+			if (reduction == MomentMatching) ws.chunkZ.resize(size_t(mcChunkSize) * mesh);
+			Philox gen(seed);
+			for (unsigned int c = firstChunk + t; c < lastChunk; c += numThreads)
+			{
+				const unsigned int first = c * mcChunkSize, last = min(iteration, first + mcChunkSize);
+				if (reduction == MomentMatching)
+					DrawMatchedChunk(ws, gen, first, last, mesh, generator);
+				else if (generator == QuasiRandom)
+					ws.sobol->skipTo(reduction == Antithetic ? first / 2 : first);
+				double hPair = 0.0;
+				for (unsigned int i = first; i < last; i++)
+				{
+					const double* z = ws.z.data();
+					if (reduction == MomentMatching)
+						z = ws.chunkZ.data() + size_t(i - first) * mesh;
+					else if (reduction == NoVarianceReduction)
+						DrawGaussians(ws, gen, i, mesh, generator, ws.z.data());
+					else if (i % 2 == 0)
+						DrawGaussians(ws, gen, i / 2, mesh, generator, ws.z.data());
+					else
+						for (auto& x : ws.z) x = -x;
+					GenerateSamplePath(_option->maturity, mesh, ws.path, z);
+					double h = payoff(ws.path);
+					if (store)
+						store->Write(firstStored + i, ws.path.data());
+					Rescale(ws.path, 1.0 + epsilon);
+					payoffStats[c].push(h);
+					bumpStats[c].push(payoff(ws.path) - h);
+					if (reduction == Antithetic)
+					{
+						if (i % 2) pairStats[c].push(0.5 * (hPair + h));
+						else hPair = h;
+					}
+				}
+			}
+		};
+		RunWorkers(numThreads, worker);
+	}
+
+	// Gaussians of draw j into z: Philox substream (seed, j), or the next Sobol point through the Brownian bridge
+	// Sobol points are sequential, the caller skips to the first one of each chunk
+	void DrawGaussians(MCWorkspace& ws, Philox& gen, unsigned int j, unsigned int mesh, randomGenerator generator, double* z)
+	{
+		if (generator == QuasiRandom)
+		{
+			ws.sobol->nextGaussians(ws.w.data());
+			ws.bridge->buildIncrements(ws.w.data(), z);
+		}
+		else
+		{
+			gen.setStream(j);
+			gen.fillGaussians(z, mesh);
 		}
-		_option->setPremium(exp(-_option->r * _option->tenor) * H);
-		PricingError = exp(-_option->r * _option->tenor) * sqrt(Hsq - H * H) / sqrt(iteration - 1.0);
-		delta = exp(-_option->r * _option->tenor) * (Heps - H) / (_option->underlyers.front().Price() * epsilon);
 	}
 
-	
+	// Draws paths [first, last) into ws.chunkZ and matches the first two moments of every step across them
+	void DrawMatchedChunk(MCWorkspace& ws, Philox& gen, unsigned int first, unsigned int last, unsigned int mesh, randomGenerator generator)
+	{
+		const unsigned int n = last - first;
+		double* Z = ws.chunkZ.data();
+		if (generator == QuasiRandom) ws.sobol->skipTo(first);
+		for (unsigned int p = 0; p < n; p++)
+			DrawGaussians(ws, gen, first + p, mesh, generator, Z + size_t(p) * mesh);
+		if (n < 2) return;
+		for (unsigned int k = 0; k < mesh; k++)
+		{
+			MCStatistics stats;
+			for (unsigned int p = 0; p < n; p++) stats.push(Z[size_t(p) * mesh + k]);
+			const double scale = 1.0 / sqrt(stats.variance());
+			for (unsigned int p = 0; p < n; p++)
+				Z[size_t(p) * mesh + k] = (Z[size_t(p) * mesh + k] - stats.mean) * scale;
+		}
+	}
+
+	// Pathwise Greeks by adjoint differentiation, instead of one bumped revaluation per Greek
+	// Chunks of mcChunkSize paths are dealt to numThreads workers as in CalculateMC, each recording on its own tape
+	// of the model's TapePool: S0, sigma, drift, r, maturity and tenor are put on it once before a mark,
+	// each path and its discounted payoff are recorded after it, propagated back to the mark and rewound,
+	// so a tape never holds more than one path and the inputs' adjoints sum the pathwise derivatives
+	// The sums are taken per chunk and reduced in chunk order, so results do not depend on numThreads
+	// Fills premium, PricingError, delta, vega, rho (drift and discount rate shifted together) and theta (-d/dT),
+	// on the paths of CalculateMC for the same seed and generator
+	void CalculateMCGreeks(unsigned int iteration = 10000, unsigned int mesh = 1, randomGenerator generator = PseudoRandom,
+		unsigned int numThreads = 1){
+		const unsigned int numChunks = (iteration + mcChunkSize - 1) / mcChunkSize;
+		numThreads = max(1u, min(numThreads, numChunks));
+		PrepareWorkspaces(numThreads);
+		// a GBM step and the payoff take a handful of nodes per date
+		tapes.prepare(numThreads, 16 * size_t(mesh) + 64);
+		vector<MCStatistics> payoffStats(numChunks);
+		enum { dS0, dVol, dMu, dRate, dMat, dTen, numInputs };
+		vector<array<double, numInputs>> inputAdjoints(numChunks);
+
+		auto worker = [&](unsigned int t) {
+			MCWorkspace& ws = workspaces[t];
+			ws.Prepare(mesh);
+			ws.pathAAD.resize(mesh);
+			if (generator == QuasiRandom) ws.PrepareQuasiRandom(mesh, seed);
+			Philox gen(seed);
+
+			const TapePool::Scope scope = tapes.use(t);
+			Tape& tape = tapes[t];
+			tape.rewind();
+			Number inputs[numInputs] = { Number(_option->underlyers.front().Price()), Number(sigma), Number(drift),
+				Number(_option->r), Number(_option->maturity), Number(_option->tenor) };
+			tape.mark();
+			for (unsigned int c = t; c < numChunks; c += numThreads)
+			{
+				const unsigned int first = c * mcChunkSize, last = min(iteration, first + mcChunkSize);
+				if (generator == QuasiRandom) ws.sobol->skipTo(first);
+				for (Number& x : inputs) x.adjoint() = 0.0;
+				for (unsigned int i = first; i < last; i++)
+				{
+					DrawGaussians(ws, gen, i, mesh, generator, ws.z.data());
+					tape.rewindToMark();
+					GenerateSamplePath(inputs[dS0], inputs[dMu], inputs[dVol], inputs[dMat], mesh, ws.pathAAD, ws.z.data());
+					Number h = exp(-inputs[dRate] * inputs[dTen]) * _option->Payoff(ws.pathAAD);
+					h.propagateToMark();
+					payoffStats[c].push(h.value());
+				}
+				// the inputs are leaves, their adjoints are complete without propagating the start of the tape
+				for (unsigned int k = 0; k < numInputs; k++) inputAdjoints[c][k] = inputs[k].adjoint();
+			}
+			tape.rewind();
+		};
+		RunWorkers(numThreads, worker);
+
+		MCStatistics H;
+		array<double, numInputs> sums = {};
+		for (unsigned int c = 0; c < numChunks; c++)
+		{
+			H.merge(payoffStats[c]);
+			for (unsigned int k = 0; k < numInputs; k++) sums[k] += inputAdjoints[c][k];
+		}
+		_option->setPremium(H.mean);
+		PricingError = H.stdError();
+		delta = sums[dS0] / iteration;
+		vega = sums[dVol] / iteration;
+		rho = (sums[dMu] + sums[dRate]) / iteration;
+		theta = -(sums[dMat] + sums[dTen]) / iteration;
+		PathsUsed = iteration;
+	}
+
+	// Same estimator on SIMD path blocks of pathBlockSize paths (see GeneratePathBlock),
+	// with payoffs evaluated across each block by Option::PayoffBlock
+	// Chunking and seeding are those of CalculateMC, so results do not depend on numThreads either
+	void CalculateMCBlock(unsigned int iteration = 10000, unsigned int mesh = 1, double epsilon = 0.0001, unsigned int numThreads = 1){
+		const unsigned int numChunks = (iteration + mcChunkSize - 1) / mcChunkSize;
+		vector<MCStatistics> payoffStats(numChunks), bumpStats(numChunks);
+		numThreads = max(1u, min(numThreads, numChunks));
+
+		PrepareWorkspaces(numThreads);
+
+		auto worker = [&](unsigned int t) {
+			MCWorkspace& ws = workspaces[t];
+			ws.PrepareBlock(mesh, pathBlockSize);
+			PathBlock& block = ws.block;
+			vector<double>& h = ws.h;
+			vector<double>& heps = ws.heps;
+			for (unsigned int c = t; c < numChunks; c += numThreads)
+			{
+				unsigned int last = min(iteration, (c + 1) * mcChunkSize);
+				for (unsigned int first = c * mcChunkSize; first < last; first += pathBlockSize)
+				{
+					GeneratePathBlock(_option->maturity, mesh, first, block);
+					_option->PayoffBlock(block, h.data(), ws.payoffScratch);
+					block.Rescale(1.0 + epsilon);
+					_option->PayoffBlock(block, heps.data(), ws.payoffScratch);
+					for (unsigned int p = 0; p < min(pathBlockSize, last - first); p++)
+					{
+						payoffStats[c].push(h[p]);
+						bumpStats[c].push(heps[p] - h[p]);
+					}
+				}
+			}
+		};
+		RunWorkers(numThreads, worker);
+		SetMCResults(payoffStats, bumpStats, epsilon);
+		PathsUsed = iteration;
+	}
+
+	// Paths kept by CalculateMC(storeSamples = true), in path order
+	// In memory by default; SetPathStore(make_shared<MappedPathStore>(file)) streams them to disk instead
+	// Copies of the model share the store
+	const PathStore& Samples() const { return *path_hist; }
+	void SetPathStore(shared_ptr<PathStore> store) { path_hist = store; }
+
+	// Runs worker(0..numThreads-1), on the calling thread when there is only one
+	// An exception on a worker thread is kept until all workers are joined, then the first one (by worker) is rethrown
+	template <class Worker>
+	static void RunWorkers(unsigned int numThreads, Worker& worker)
+	{
+		if (numThreads <= 1) { worker(0); return; }
+		vector<exception_ptr> errors(numThreads);
+		vector<thread> workers;
+		for (unsigned int t = 0; t < numThreads; t++)
+			workers.emplace_back([&worker, &errors, t] {
+				try { worker(t); }
+				catch (...) { errors[t] = current_exception(); }
+			});
+		for (auto& w : workers) w.join();
+		for (auto& e : errors) if (e) rethrow_exception(e);
+	}
+
+	// One workspace per worker, kept across calls
+	void PrepareWorkspaces(unsigned int numThreads)
+	{
+		if (workspaces.size() < numThreads) workspaces.resize(numThreads);
+	}
+
+	// Generation parameters recorded with stored samples
+	PathStoreInfo SampleInfo(unsigned int mesh) const
+	{
+		PathStoreInfo info;
+		info.mesh = mesh;
+		info.seed = seed;
+		info.maturity = _option->maturity;
+		info.spot = _option->underlyers.front().Price();
+		info.drift = drift;
+		info.sigma = sigma;
+		return info;
+	}
+
+	// Merges per-chunk accumulators in chunk order into premium, PricingError, VarianceReductionFactor and delta
+	// pairStats holds the antithetic pair averages
+	void SetMCResults(const vector<MCStatistics>& payoffStats, const vector<MCStatistics>& bumpStats, double epsilon,
+		varianceReduction reduction = NoVarianceReduction, const vector<MCStatistics>& pairStats = {})
+	{
+		MCStatistics H, dH, units;
+		for (size_t c = 0; c < payoffStats.size(); c++)
+		{
+			H.merge(payoffStats[c]);
+			dH.merge(bumpStats[c]);
+			if (reduction == Antithetic) units.merge(pairStats[c]);
+			if (reduction == MomentMatching) units.push(payoffStats[c].mean);
+		}
+		double error = H.stdError();
+		if (reduction == Antithetic || (reduction == MomentMatching && units.count > 1))
+		{
+			const double reduced = units.stdError();
+			VarianceReductionFactor = reduced > 0.0 ? error * error / (reduced * reduced) : 1.0;
+			error = reduced;
+		}
+		else VarianceReductionFactor = 1.0;
+		_option->setPremium(exp(-_option->r * _option->tenor) * H.mean);
+		PricingError = exp(-_option->r * _option->tenor) * error;
+		delta = exp(-_option->r * _option->tenor) * dH.mean / (_option->underlyers.front().Price() * epsilon);
+	}
+
 	// Pricing using Variance Reduction and Monte Carlo
 	// Here CV stands for Control Variate
 	void CalcVarReducMC(Option& CVOption, unsigned int iteration = 10000, unsigned int mesh = 1, double epsilon = 0.0001, priceProcess type = BS) {
 		DifferenceOfOptions VarRedOpt(_option->tenor, _option->maturity, _option, &CVOption);
 		// assign a similar BS model for VC option
 		auto CVmodel = BSModel(&VarRedOpt);
+		CVmodel.seed = seed;
 		CVmodel.CalculateMC(iteration, mesh, epsilon);
 		// variations depending on complexity and price process: 
 		double Price;//, Delta;
@@ -61,8 +401,36 @@ public:
 		for (size_t j = 0; j < m; j++) S[j] = x * S[j];
 	}
 
+	// number of paths per accumulator, fixed so results do not depend on the thread count
+	static constexpr unsigned int mcChunkSize = 1024;
+	// number of paths generated together by GeneratePathBlock, divides mcChunkSize
+	static constexpr unsigned int pathBlockSize = 256;
+
 private:
-	vector<SamplePath> path_hist;
+	// Body of CalculateMC and CalculateMCInline, payoff(path) as in SimulateChunks
+	template <class Payoff>
+	void RunMC(unsigned int iteration, unsigned int mesh, double epsilon, bool storeSamples,
+		unsigned int numThreads, randomGenerator generator, varianceReduction reduction, const Payoff& payoff){
+		if (reduction == Antithetic) iteration += iteration & 1;
+		const unsigned int numChunks = (iteration + mcChunkSize - 1) / mcChunkSize;
+		vector<MCStatistics> payoffStats(numChunks), bumpStats(numChunks), pairStats(reduction == Antithetic ? numChunks : 0);
+		PathStore* store = nullptr;
+		size_t firstStored = 0;
+		if (storeSamples)
+		{
+			store = path_hist.get();
+			firstStored = store->Append(SampleInfo(mesh), iteration);
+		}
+		SimulateChunks(0, numChunks, iteration, mesh, epsilon, numThreads, generator, reduction,
+			payoffStats, bumpStats, pairStats, store, firstStored, payoff);
+		if (store) store->Flush();
+		SetMCResults(payoffStats, bumpStats, epsilon, reduction, pairStats);
+		PathsUsed = iteration;
+	}
+
+	shared_ptr<PathStore> path_hist = make_shared<MemoryPathStore>();	// stored samples
+	vector<MCWorkspace> workspaces;	// per-thread scratch memory of the MC engines
+	TapePool tapes;					// per-thread AAD tapes of CalculateMCGreeks
 };
 
 void BSModel::GenerateSamplePath(double T, int m, SamplePath& S)
@@ -76,6 +444,66 @@ void BSModel::GenerateSamplePath(double T, int m, SamplePath& S)
 		St = S[k];
 	}
 };
+
+// Same scheme on pre-drawn standard Gaussians z[0..m-1]
+void BSModel::GenerateSamplePath(double T, int m, SamplePath& S, const double* z)
+{
+	GenerateSamplePath(_option->underlyers[0].Price(), drift, sigma, T, m, S, z);
+};
+
+// Generic in the number type: double, or Number to record the path on the AAD tape
+// with one node per step on top of the three for the step constants
+template <class T>
+void BSModel::GenerateSamplePath(const T& S0, const T& mu, const T& vol, const T& mat, int m, vector<T>& S, const double* z)
+{
+	S.resize(m);
+	const T dt = mat / double(m);
+	const T mudt = (mu - vol * vol * 0.5) * dt;
+	const T voldt = vol * sqrt(dt);
+	S[0] = S0 * exp(mudt + voldt * z[0]);
+	for (int k = 1; k < m; k++)
+		S[k] = S[k - 1] * exp(mudt + voldt * z[k]);
+};
+
+// Log-Euler GBM for paths firstPath, firstPath + 1, ... filling the whole block,
+// SIMD-wide across paths: vectorised Philox, Box-Muller and exp
+// Path p uses the Gaussians of Philox substream (seed, p) like CalculateMC,
+// up to the last bit of the uniforms (52 instead of 53) and the polynomial math functions
+void BSModel::GeneratePathBlock(double T, unsigned int m, unsigned long long firstPath, PathBlock& block)
+{
+	using namespace Simd;
+	block.resize(m, block.paths());
+	const double dt = T / m;
+	const vdouble mudt = set1((drift - 0.5 * sigma * sigma) * dt), vol = set1(sigma * sqrt(dt));
+	const vdouble logS0 = set1(std::log(_option->underlyers[0].Price()));
+	const vuint64 low = set1(uint64_t(0xffffffff));
+	uint64_t lanes[width];
+
+	for (size_t p = 0; p < block.paths(); p += width)
+	{
+		for (size_t l = 0; l < width; l++) lanes[l] = firstPath + p + l;
+		const vuint64 stream = loadu(lanes);
+		const vuint64 s0 = stream & low, s1 = shiftRight<32>(stream);
+		vdouble x = logS0;
+		for (unsigned int k = 0; k < m; k += 2)
+		{
+			vuint64 c0 = set1(uint64_t(k / 2)), c1 = set1(uint64_t(0)), c2 = s0, c3 = s1;
+			philox(c0, c1, c2, c3, uint32_t(seed), uint32_t(seed >> 32));
+			const vdouble r = sqrt(set1(-2.0) * Simd::log(toUniform(c0 | shiftLeft<32>(c1))));
+			vdouble sn, cs;
+			sincos2pi(toUniform(c2 | shiftLeft<32>(c3)), sn, cs);
+
+			x = fma(vol, r * cs, x + mudt);
+			store(block.row(k) + p, Simd::exp(x));
+			if (k + 1 < m)
+			{
+				x = fma(vol, r * sn, x + mudt);
+				store(block.row(k + 1) + p, Simd::exp(x));
+			}
+		}
+	}
+};
+
 void BSModel::Update_Params(Referential hist){
     // This is where we implement how to update the drift/sigm terms from prices
 	return;
@@ -0,0 +1,198 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include <vector>
+
+using namespace std;
+
+// Black-Scholes PDE of a vanilla option in x = log S, solved backward from maturity in time to maturity tau:
+//     V_tau = sigma^2 / 2 V_xx + (mu - sigma^2 / 2) V_x - r V
+// Crank-Nicolson, each step one O(n) Thomas solve, with Rannacher start-up: the first rannacherSteps steps are
+// taken as two implicit Euler half steps each, which damps the oscillations the payoff kink excites otherwise
+// The space grid spans gridWidth standard deviations of log S at maturity beyond the spot and the strike,
+// sinh stretched so nodes are densest at the strike; boundaries are Dirichlet at the asymptotic values
+// American options are kept above their exercise value by solving each step as a complementarity problem,
+// Bermudan ones only on the first time step on or after each of exerciseDates dates equally spaced over the maturity
+// Price and Greeks are read off the grid at the spot (quadratic through the three nearest nodes),
+// theta from the PDE itself. Buffers are kept across solves and sized before the time loop, which does not allocate
+class BSPDESolver
+{
+public:
+	unsigned int spaceSteps = 400;
+	unsigned int timeSteps = 200;
+	unsigned int rannacherSteps = 2;
+	double gridWidth = 5.0;
+	double concentration = 0.1;	// sinh scale over the grid width, smaller packs more nodes at the strike
+	unsigned int exerciseDates = 50;	// Bermudan exercise only
+
+	struct Result
+	{
+		double price = 0.0, delta = 0.0, gamma = 0.0;
+		double theta = 0.0;	// per year of calendar time, -dV/dT
+	};
+
+	// mu is the growth rate of the spot (r less dividends), r the discount rate
+	// american: exercise at every time step, bermudan: on the exerciseDates dates, neither: European
+	Result Solve(double S0, double K, double T, double r, double mu, double sigma, bool isCall, bool american, bool bermudan = false)
+	{
+		if (!(S0 > 0.0) || !(K > 0.0) || !(T > 0.0) || !(sigma > 0.0) || spaceSteps < 4 || timeSteps == 0)
+			throw invalid_argument("BSPDESolver: spot, strike, maturity, vol and grid sizes must be positive");
+		const size_t n = spaceSteps;
+		x.resize(n + 1);
+		V.resize(n + 1);
+		exercise.resize(n + 1);
+		l.resize(n + 1);
+		d.resize(n + 1);
+		u.resize(n + 1);
+		rhs.resize(n + 1);
+		work.resize(n + 1);
+		inversePivot.resize(n + 1);
+		coupling.resize(n + 1);
+
+		// grid
+		const double x0 = log(S0), xK = log(K), sd = sigma * sqrt(T);
+		const double xMin = min(x0, xK) - gridWidth * sd, xMax = max(x0, xK) + gridWidth * sd;
+		const double alpha = concentration * (xMax - xMin);
+		const double c1 = asinh((xMin - xK) / alpha), c2 = asinh((xMax - xK) / alpha);
+		for (size_t i = 0; i <= n; i++) x[i] = xK + alpha * sinh(c1 + (c2 - c1) * double(i) / double(n));
+		x.front() = xMin;
+		x.back() = xMax;
+
+		// L V = a V_xx + b V_x - r V on the non-uniform grid, row i is l V_i-1 + d V_i + u V_i+1
+		const double a = 0.5 * sigma * sigma, b = mu - a;
+		for (size_t i = 1; i < n; i++)
+		{
+			const double hm = x[i] - x[i - 1], hp = x[i + 1] - x[i], hs = hm + hp;
+			l[i] = (2.0 * a - b * hp) / (hm * hs);
+			d[i] = (-2.0 * a + b * (hp - hm)) / (hm * hp) - r;
+			u[i] = (2.0 * a + b * hm) / (hp * hs);
+		}
+
+		const double w = isCall ? 1.0 : -1.0;
+		for (size_t i = 0; i <= n; i++) V[i] = exercise[i] = max(0.0, w * (exp(x[i]) - K));
+
+		// Crank-Nicolson and the implicit Euler half steps share the matrix I - dt / 2 L, factored once
+		const double dt = T / timeSteps;
+		Factor(0.5 * dt, w);
+		double tau = 0.0;
+		for (unsigned int step = 0; step < timeSteps; step++)
+		{
+			// the step ends on time level timeSteps - step - 1 from today
+			const bool exercisable = american || (bermudan && Exercisable(timeSteps - step - 1));
+			if (step < rannacherSteps)
+			{
+				Step(0.0, tau + 0.5 * dt, K, r, mu, w, exercisable);
+				Step(0.0, tau + dt, K, r, mu, w, exercisable);
+			}
+			else Step(0.5 * dt, tau + dt, K, r, mu, w, exercisable);
+			tau += dt;
+		}
+
+		// quadratic through the nodes around the spot
+		const size_t j = min(n - 1, max(size_t(1), size_t(lower_bound(x.begin(), x.end(), x0) - x.begin())));
+		const size_t i = x0 - x[j - 1] < x[j] - x0 ? max(size_t(1), j - 1) : j;
+		const double xm = x[i - 1], xc = x[i], xp = x[i + 1];
+		const double wm = 1.0 / ((xm - xc) * (xm - xp)), wc = 1.0 / ((xc - xm) * (xc - xp)), wp = 1.0 / ((xp - xm) * (xp - xc));
+		const double Vx = V[i - 1] * wm * (2.0 * x0 - xc - xp) + V[i] * wc * (2.0 * x0 - xm - xp) + V[i + 1] * wp * (2.0 * x0 - xm - xc);
+		const double Vxx = 2.0 * (V[i - 1] * wm + V[i] * wc + V[i + 1] * wp);
+		Result result;
+		result.price = V[i - 1] * wm * (x0 - xc) * (x0 - xp) + V[i] * wc * (x0 - xm) * (x0 - xp) + V[i + 1] * wp * (x0 - xm) * (x0 - xc);
+		result.delta = Vx / S0;
+		result.gamma = (Vxx - Vx) / (S0 * S0);
+		// V_tau = L V where the option is held, 0 where it is exercised
+		const bool exercised = american && V[i - 1] == exercise[i - 1] && V[i] == exercise[i] && V[i + 1] == exercise[i + 1];
+		result.theta = exercised ? 0.0 : -(a * Vxx + b * Vx - r * result.price);
+		return result;
+	}
+
+	// Grid and option values of the last solve, in log spot
+	const vector<double>& Grid() const { return x; }
+	const vector<double>& Values() const { return V; }
+
+private:
+	vector<double> x, V, exercise;
+	vector<double> l, d, u;		// space operator
+	vector<double> rhs, work, inversePivot, coupling;	// Thomas factors
+	double implicitPart = 0.0;
+
+	// Whether time level i (0 <= i < timeSteps) is a Bermudan exercise date, as LatticeEngine
+	bool Exercisable(unsigned long long i) const
+	{
+		if (i == 0) return false;
+		const unsigned long long D = exerciseDates, n = timeSteps;
+		return i * D / n != (i - 1) * D / n;
+	}
+
+	// LU factors of I - implicitPart L on rows 1..n-1 (Thomas), eliminating towards the side the substitution starts from,
+	// kept as inverse pivots and scaled couplings so each elimination step is a single multiply-add on the dependency chain
+	// For puts V_i = rhs_i - work_i V_i-1 from the top down, otherwise V_i = rhs_i - work_i V_i+1 from the bottom up
+	void Factor(double dt, double w)
+	{
+		const size_t n = V.size() - 1;
+		implicitPart = dt;
+		if (w > 0.0)
+			for (size_t i = 1; i < n; i++)
+			{
+				const double sub = -implicitPart * l[i];
+				inversePivot[i] = 1.0 / (1.0 - implicitPart * d[i] - (i > 1 ? sub * work[i - 1] : 0.0));
+				coupling[i] = sub * inversePivot[i];
+				work[i] = -implicitPart * u[i] * inversePivot[i];
+			}
+		else
+			for (size_t i = n - 1; i >= 1; i--)
+			{
+				const double super = -implicitPart * u[i];
+				inversePivot[i] = 1.0 / (1.0 - implicitPart * d[i] - (i + 1 < n ? super * work[i + 1] : 0.0));
+				coupling[i] = super * inversePivot[i];
+				work[i] = -implicitPart * l[i] * inversePivot[i];
+			}
+	}
+
+	// One step of V to time to maturity tauNext: (I - implicitPart L) V_next = (I + explicitPart L) V
+	void Step(double explicitPart, double tauNext, double K, double r, double mu, double w, bool american)
+	{
+		const size_t n = V.size() - 1;
+		if (explicitPart > 0.0)
+			for (size_t i = 1; i < n; i++) rhs[i] = V[i] + explicitPart * (l[i] * V[i - 1] + d[i] * V[i] + u[i] * V[i + 1]);
+		else
+			for (size_t i = 1; i < n; i++) rhs[i] = V[i];
+
+		// asymptotic values at the ends: deep out of the money 0, deep in the money the discounted forward payoff
+		const double forwardFactor = exp((mu - r) * tauNext), discount = exp(-r * tauNext);
+		double low = max(0.0, w * (exp(x[0]) * forwardFactor - K * discount));
+		double high = max(0.0, w * (exp(x[n]) * forwardFactor - K * discount));
+		if (american)
+		{
+			low = max(low, exercise[0]);
+			high = max(high, exercise[n]);
+		}
+		V[0] = low;
+		V[n] = high;
+
+		// the substitution runs out of the exercise region (low spots for puts, high spots for calls) and projects
+		// on the exercise value as it goes (Brennan-Schwartz), which solves the American complementarity problem exactly
+		// when the exercise region is one side of the grid
+		auto project = [&](size_t i) { if (american) V[i] = max(V[i], exercise[i]); };
+		if (w > 0.0)
+		{
+			rhs[1] = (rhs[1] + implicitPart * l[1] * low) * inversePivot[1];
+			for (size_t i = 2; i < n; i++) rhs[i] = rhs[i] * inversePivot[i] - coupling[i] * rhs[i - 1];
+			for (size_t i = n; i-- > 1;)
+			{
+				V[i] = rhs[i] - work[i] * V[i + 1];
+				project(i);
+			}
+		}
+		else
+		{
+			rhs[n - 1] = (rhs[n - 1] + implicitPart * u[n - 1] * high) * inversePivot[n - 1];
+			for (size_t i = n - 1; i-- > 1;) rhs[i] = rhs[i] * inversePivot[i] - coupling[i] * rhs[i + 1];
+			for (size_t i = 1; i < n; i++)
+			{
+				V[i] = rhs[i] - work[i] * V[i - 1];
+				project(i);
+			}
+		}
+	}
+};
@@ -1,25 +1,45 @@
-#include "../pricers/option.hpp"
-#include "model.hpp"
-#include"../market/market.hpp"
 #pragma once
+#include "BSModel.h"
 using namespace Derivatives;
 
-class Bachelier : public Model
+// Normal model, named BachelierModel as Derivatives::Bachelier is the priceProcess enumerator
+
+class BachelierModel : public Model
 {
 public:
 	Option* _option;
-	Bachelier(Option* option):_option(option)
+	BachelierModel(Option* option):_option(option)
 	{
 		path_hist = vector<SamplePath>();
 		Update_Params();
 	}
-	Bachelier(const BModel& mod1) : _option(mod1._option), path_hist(mod1.path_hist) { Update_Params(); };
+	BachelierModel(const BachelierModel& mod1) : Model(mod1), _option(mod1._option), path_hist(mod1.path_hist) { Update_Params(); };
 
 	void GenerateSamplePath(double T, int m, SamplePath& S);
 	void Update_Params();
 	void Update_Params(Referential hist);
 	void Update_Params(double mu, double sig);
 
+	// Closed form for the dynamics of GenerateSamplePath, dS = drift S dt + sigma dW:
+	// S_T is normal with mean S0 exp(drift T) and variance sigma^2 (exp(2 drift T) - 1) / (2 drift),
+	// i.e. the Bachelier formula with normal vol ForwardVol() on the forward (BachelierBatch.h for whole chains)
+	double ForwardVol() const
+	{
+		const double T = _option->maturity, growth = drift * T;
+		return sigma * (abs(growth) < 1e-8 ? 1.0 + 0.5 * growth : sqrt(expm1(2.0 * growth) / (2.0 * growth)));
+	}
+
+	// Sets the option premium, and delta with respect to spot
+	void CalculateByFormula()
+	{
+		const double T = _option->maturity, sqrtT = sqrt(T), w = _option->isCall ? 1.0 : -1.0;
+		const double F = _option->underlyers.front().Price() * exp(drift * T), volT = ForwardVol() * sqrtT;
+		const double d = (F - _option->strike) / volT, df = exp(-_option->r * _option->tenor);
+		_option->setPremium(df * (w * (F - _option->strike) * N(w * d) + volT * normalDens(d)));
+		PricingError = 0.0;
+		delta = df * exp(drift * T) * w * N(w * d);
+	}
+
 	// Naive Monte Carlo - expected to be slow (Compiler please carry my vectorization)
 	void CalculateMC(unsigned int iteration = 10000, unsigned int mesh = 1, double epsilon = 0.0001, bool storeSamples = false){
 		double H = 0.0, Hsq = 0.0, Heps = 0.0;
@@ -65,30 +85,32 @@ private:
 	vector<SamplePath> path_hist;
 };
 
-void BSModel::GenerateSamplePath(double T, int m, SamplePath& S)
+void BachelierModel::GenerateSamplePath(double T, int m, SamplePath& S)
 {
 	S.resize(m);
 	S[0] = _option->underlyers[0].Price();
 	double St = S[0];
+	const double growth = drift * (T / m);
 	for (int k = 0; k < m; k++)
 	{
-		auto var_scaling = sqrt(sigma * sigma / 2 / drift * (exp(2 * drift * (T / m)) - 1));
+		// exact step variance, sigma^2 T / m without drift
+		auto var_scaling = sigma * sqrt(T / m) * (abs(growth) < 1e-8 ? 1.0 + 0.5 * growth : sqrt(expm1(2 * growth) / (2 * growth)));
 		S[k] = St * exp(drift * (T/m)) + var_scaling * Gauss();
 		St = S[k];
 	}
 };
-void BSModel::Update_Params(Referential hist){
+void BachelierModel::Update_Params(Referential hist){
     // This is where we implement how to update the drift/sigm terms from prices
 	return;
 };
 
-void BSModel::Update_Params() {
+void BachelierModel::Update_Params() {
 	// Default update taking forward rate as drift and vol as implied vol
 	drift = _option->r;
 	sigma = _option->impliedVol();
 }
 
-void BSModel::Update_Params(double mu, double sig){
+void BachelierModel::Update_Params(double mu, double sig){
     drift = mu;
     sigma = sig;
 };
\ No newline at end of file
@@ -0,0 +1,94 @@
+#pragma once
+#include "BSBatch.h"
+
+// Bachelier (normal model) closed form over whole option chains, same layout and conventions as BSBatch.h
+// chain.vol holds normal vols of the forward F = S exp(rT), in price units per sqrt(year):
+//     price = exp(-rT) (w (F - K) N(w d) + vol sqrt(T) n(d)),   d = (F - K) / (vol sqrt(T))
+// Greeks are with respect to spot, normal vol and rate, theta per year of calendar time (-d/dT)
+
+inline void PriceByBachelierFormula(const OptionChain& chain, ChainGreeks& out)
+{
+	using namespace Simd;
+	out.resize(chain.size());
+	const vdouble half = set1(0.5);
+	for (size_t i = 0; i < chain.size(); i += width)
+	{
+		const vdouble S = load(chain.spot.data() + i), K = load(chain.strike.data() + i);
+		const vdouble T = load(chain.tenor.data() + i), r = load(chain.rate.data() + i);
+		const vdouble sigma = load(chain.vol.data() + i), w = load(chain.isCall.data() + i);
+
+		const vdouble sqrtT = sqrt(T), volT = sigma * sqrtT;
+		const vdouble df = Simd::exp(-r * T), F = S / df;
+		const vdouble d = (F - K) / volT;
+		const vdouble Nd = normalCdf(w * d), nd = normalDens(d);
+		// undiscounted price, and its derivatives in F and in vol sqrt(T)
+		const vdouble undiscounted = fma(w * (F - K), Nd, volT * nd);
+		const vdouble price = df * undiscounted;
+
+		store(out.price.data() + i, price);
+		store(out.delta.data() + i, w * Nd);
+		store(out.gamma.data() + i, nd / (df * volT));
+		store(out.vega.data() + i, df * sqrtT * nd);
+		store(out.theta.data() + i, r * price - df * fma(w * Nd * r, F, nd * sigma * half / sqrtT));
+		store(out.rho.data() + i, T * (w * Nd * S - price));
+	}
+}
+
+// Normal implied volatilities of a chain out of prices[0..chain.size()-1], written to chain.vol
+// Jaeckel's closed form ("Implied normal volatility", 2017): with x = -|F - K| / (vol sqrt(T)) the time value is
+// -|F - K| phi~(x), phi~(x) = N(x) + n(x) / x, which is inverted by a rational approximation in one of two regions
+// followed by one third-order Householder step, to about machine precision without iterating
+// At the money the price is linear in vol; there is no upper bound, status is IVBelowIntrinsic or IVConverged
+inline void ImpliedNormalVolByBachelierFormula(OptionChain& chain, const double* prices, std::vector<impliedVolStatus>& status)
+{
+	using namespace Simd;
+	const size_t n = chain.size();
+	status.resize(n);
+	const vdouble zero = set1(0.0), one = set1(1.0), two = set1(2.0), three = set1(3.0), six = set1(6.0);
+	alignas(alignment) double padded[width], flag[width];
+
+	for (size_t i = 0; i < n; i += width)
+	{
+		// last register: pad the prices, the padding option is ATM
+		const double* px = prices + i;
+		if (i + width > n)
+		{
+			for (size_t l = 0; l < width; l++) padded[l] = i + l < n ? prices[i + l] : 0.4;
+			px = padded;
+		}
+		const vdouble S = load(chain.spot.data() + i), K = load(chain.strike.data() + i);
+		const vdouble T = load(chain.tenor.data() + i), r = load(chain.rate.data() + i);
+		const vdouble w = load(chain.isCall.data() + i), price = loadu(px);
+
+		const vdouble df = Simd::exp(-r * T), F = S / df;
+		const vdouble distance = abs(F - K);
+		const vdouble timeValue = price / df - max(zero, w * (F - K));
+		const vmask below = timeValue < zero || timeValue == zero;
+		const vmask atm = distance == zero;
+
+		// target phi~* = -time value / |F - K| < 0
+		const vdouble target = -timeValue / distance;
+		// phi~* < -0.001882: rational in g = 1 / (phi~* - 1/2)
+		const vdouble g = one / (target - set1(0.5)), g2 = g * g;
+		const vdouble xi = (set1(0.032114372355) - g2 * (set1(0.016969777977) - g2 * (set1(2.6207332461e-3) - set1(9.6066952861e-5) * g2)))
+			/ (one - g2 * (set1(0.6635646938) - g2 * (set1(0.14528712196) - set1(0.010472855461) * g2)));
+		const vdouble xCentral = g * (set1(0.3989422804014327) + xi * g2);
+		// otherwise rational in h = sqrt(-log(-phi~*))
+		const vdouble h = sqrt(-Simd::log(-target));
+		const vdouble xTail = (set1(9.4883409779) - h * (set1(9.6320903635) - h * (set1(0.58556997323) + set1(2.1464093351) * h)))
+			/ (one - h * (set1(0.65174820867) + h * (set1(1.5120247828) + set1(6.6437847132e-5) * h)));
+		const vdouble x = select(target < set1(-0.001882039271), xCentral, xTail);
+
+		// one Householder step on phi~(x) = phi~*, phi~'(x) = n(x) / x^2
+		const vdouble nx = normalDens(x), x2 = x * x;
+		const vdouble q = (normalCdf(x) + nx / x - target) / nx;
+		const vdouble qx = q * x;
+		const vdouble root = x + three * qx * x * (two - qx * (two + x2))
+			/ (six + qx * (set1(-12.0) + x * (six * q + x * (set1(-6.0) + qx * (three + x2)))));
+
+		const vdouble vol = select(atm, price / df * set1(2.5066282746310002), distance / abs(root)) / sqrt(T);
+		store(chain.vol.data() + i, select(below, zero, vol));
+		store(flag, select(below, set1(double(IVBelowIntrinsic)), set1(double(IVConverged))));
+		for (size_t l = 0; l < width && i + l < n; l++) status[i + l] = impliedVolStatus(int(flag[l]));
+	}
+}
@@ -0,0 +1,210 @@
+#pragma once
+#include "BSModel.h"
+#include "../math_library/matrix.h"
+
+// Longstaff-Schwartz Monte Carlo for American and Bermudan options on one underlyer
+// The option can be exercised for max(0, w (S - K)) at exerciseDates dates equally spaced over its maturity,
+// the last one being maturity; an American option is priced as its Bermudan counterpart on a fine grid
+// and may also be exercised at once, a European one has maturity as its only date and Asian options are rejected
+// The spots of every path at the exercise dates are kept in one PathBlock (row k: date k, across paths),
+// generated by BSModel::GeneratePathBlock, so paths are those of CalculateMCBlock for the same seed and mesh
+// Backward induction regresses the discounted cash flows of in-the-money paths on 1, x, ..., x^(basisSize - 1),
+// x = S / K: the normal equations are accumulated per chunk of mcChunkSize paths by numThreads workers,
+// merged in chunk order and solved by Cholesky on a MatLib::Matrix, so results do not depend on numThreads
+// The premium is the value of the fitted exercise policy on the same paths, delta pathwise with the exercise dates
+// held. With reuseCoefficients the regressions of the previous run are kept and only the policy is valued,
+// for bump-and-revalue Greeks at the cost of a European Monte Carlo
+class LSMCEngine
+{
+public:
+	unsigned int basisSize = 4;
+	unsigned int numThreads = 1;
+
+	explicit LSMCEngine(BSModel& model) : model(model) {}
+
+	// Sets the option premium and the model's PricingError, delta and PathsUsed
+	void Calculate(unsigned int iteration = 10000, unsigned int exerciseDates = 50, double epsilon = 0.0001, bool reuseCoefficients = false)
+	{
+		if (exerciseDates == 0) throw invalid_argument("LSMCEngine: no exercise date");
+		if (basisSize == 0 || basisSize > maxBasis) throw invalid_argument("LSMCEngine: basisSize must be in 1.." + to_string(maxBasis));
+		Option* option = model._option;
+		if (option->getStyle() == Asian) throw invalid_argument("LSMCEngine: no early exercise for Asian options");
+		if (option->getStyle() == European) exerciseDates = 1;
+		const unsigned int M = exerciseDates, B = basisSize, chunk = BSModel::mcChunkSize;
+		const unsigned int numChunks = (iteration + chunk - 1) / chunk;
+		const unsigned int threads = max(1u, min(numThreads, numChunks));
+		strike = option->strike;
+		sign = option->isCall ? 1.0 : -1.0;
+		stepDiscount = exp(-option->r * option->tenor / M);
+		const bool regress = !reuseCoefficients || coefficients.size() != M - 1 || basisSize != regressedBasis;
+
+		// path states at the exercise dates
+		states.resize(M, iteration);
+		auto generate = [&](unsigned int t) {
+			PathBlock block(M, BSModel::pathBlockSize);
+			for (unsigned int c = t; c < numChunks; c += threads)
+				for (unsigned int first = c * chunk; first < min(iteration, (c + 1) * chunk); first += BSModel::pathBlockSize)
+				{
+					model.GeneratePathBlock(option->maturity, M, first, block);
+					const size_t count = min(size_t(BSModel::pathBlockSize), states.paths() - first);
+					for (unsigned int k = 0; k < M; k++) copy(block.row(k), block.row(k) + count, states.row(k) + first);
+				}
+		};
+		BSModel::RunWorkers(threads, generate);
+
+		if (regress)
+		{
+			// cash flows of each path seen from the current date, and per chunk normal equations (lower triangle, then b)
+			coefficients.assign(M - 1, vector<double>());
+			cashflows.resize(iteration);
+			vector<double> normal(size_t(numChunks) * (B * B + B));
+			vector<unsigned int> inTheMoney(numChunks);
+			for (unsigned int date = M - 1; date-- > 0;)
+			{
+				auto accumulate = [&](unsigned int t) {
+					double phi[maxBasis];
+					for (unsigned int c = t; c < numChunks; c += threads)
+					{
+						double* A = normal.data() + size_t(c) * (B * B + B);
+						double* b = A + B * B;
+						fill(A, A + B * B + B, 0.0);
+						inTheMoney[c] = 0;
+						for (unsigned int p = c * chunk; p < min(iteration, (c + 1) * chunk); p++)
+						{
+							// cash flow at date + 1: maturity payoff, or exercise under the policy fitted there
+							const double next = states(date + 1, p);
+							if (date + 2 == M) cashflows[p] = Exercise(next);
+							else if (Exercises(date + 1, next)) cashflows[p] = Exercise(next);
+							cashflows[p] *= stepDiscount;
+
+							const double S = states(date, p);
+							if (Exercise(S) <= 0.0) continue;
+							inTheMoney[c]++;
+							Basis(S, phi);
+							for (unsigned int i = 0; i < B; i++)
+							{
+								b[i] += phi[i] * cashflows[p];
+								for (unsigned int j = 0; j <= i; j++) A[i * B + j] += phi[i] * phi[j];
+							}
+						}
+					}
+				};
+				BSModel::RunWorkers(threads, accumulate);
+
+				MatLib::Matrix A(B, B);
+				vector<double> b(B, 0.0);
+				unsigned int count = 0;
+				for (unsigned int c = 0; c < numChunks; c++)
+				{
+					const double* Ac = normal.data() + size_t(c) * (B * B + B);
+					for (unsigned int i = 0; i < B; i++)
+					{
+						b[i] += Ac[B * B + i];
+						for (unsigned int j = 0; j <= i; j++) A(i, j) += Ac[i * B + j];
+					}
+					count += inTheMoney[c];
+				}
+				// too few exercisable paths to regress on: never exercise at this date
+				if (count >= B && A.choleskySolve(b.data())) coefficients[date] = b;
+			}
+			regressedBasis = B;
+		}
+
+		// value of the exercise policy, and of the same cash flows on paths rescaled by 1 + epsilon
+		// (exercise dates held, which is the pathwise delta of the optimal policy by the envelope theorem
+		// and avoids the noise of exercise decisions flipping under the bump)
+		vector<double> discount(M);
+		for (unsigned int k = 0; k < M; k++) discount[k] = k ? discount[k - 1] * stepDiscount : stepDiscount;
+		vector<MCStatistics> payoffStats(numChunks), bumpStats(numChunks);
+		vector<unsigned int> early(numChunks);
+		auto value = [&](unsigned int t) {
+			for (unsigned int c = t; c < numChunks; c += threads)
+			{
+				early[c] = 0;
+				for (unsigned int p = c * chunk; p < min(iteration, (c + 1) * chunk); p++)
+				{
+					const unsigned int k = StoppingDate(p);
+					const double S = states(k, p), h = discount[k] * Exercise(S);
+					payoffStats[c].push(h);
+					bumpStats[c].push(discount[k] * Exercise((1.0 + epsilon) * S) - h);
+					early[c] += k + 1 < M;
+				}
+			}
+		};
+		BSModel::RunWorkers(threads, value);
+
+		MCStatistics H, dH;
+		unsigned int exercisedEarly = 0;
+		for (unsigned int c = 0; c < numChunks; c++)
+		{
+			H.merge(payoffStats[c]);
+			dH.merge(bumpStats[c]);
+			exercisedEarly += early[c];
+		}
+		const double S0 = option->underlyers.front().Price();
+		double premium = H.mean, delta = dH.mean / (S0 * epsilon);
+		exerciseProbability = double(exercisedEarly) / iteration;
+		immediateExercise = option->getStyle() == American && Exercise(S0) > premium;
+		if (immediateExercise)
+		{
+			premium = Exercise(S0);
+			delta = sign;
+		}
+		option->setPremium(premium);
+		model.PricingError = immediateExercise ? 0.0 : H.stdError();
+		model.delta = delta;
+		model.PathsUsed = iteration;
+	}
+
+	// Regression coefficients of exercise date k < exerciseDates - 1 in the last run, empty when there was
+	// nothing to regress on (the option is not exercised at that date)
+	const vector<double>& Coefficients(size_t k) const { return coefficients[k]; }
+
+	// Fraction of paths exercised before maturity by the policy in the last run
+	double EarlyExerciseProbability() const { return exerciseProbability; }
+
+	// Whether the last run found an American option worth exercising at once
+	bool ImmediateExercise() const { return immediateExercise; }
+
+private:
+	static constexpr unsigned int maxBasis = 16;
+
+	BSModel& model;
+	PathBlock states;
+	vector<double> cashflows;
+	vector<vector<double>> coefficients;
+	unsigned int regressedBasis = 0;
+	double strike = 0.0, sign = 1.0, stepDiscount = 1.0;
+	double exerciseProbability = 0.0;
+	bool immediateExercise = false;
+
+	double Exercise(double S) const { return max(0.0, sign * (S - strike)); }
+
+	void Basis(double S, double* phi) const
+	{
+		const double x = S / strike;
+		phi[0] = 1.0;
+		for (unsigned int i = 1; i < basisSize; i++) phi[i] = phi[i - 1] * x;
+	}
+
+	// Policy at exercise date k: exercise when in the money and worth at least the regressed continuation value
+	bool Exercises(unsigned int k, double S) const
+	{
+		const vector<double>& beta = coefficients[k];
+		const double e = Exercise(S);
+		if (e <= 0.0 || beta.empty()) return false;
+		double phi[maxBasis], continuation = 0.0;
+		Basis(S, phi);
+		for (unsigned int i = 0; i < beta.size(); i++) continuation += beta[i] * phi[i];
+		return e >= continuation;
+	}
+
+	// First exercise date of path p under the policy, the last date when it is held to maturity
+	unsigned int StoppingDate(size_t p) const
+	{
+		const unsigned int M = states.steps();
+		for (unsigned int k = 0; k + 1 < M; k++)
+			if (Exercises(k, states(k, p))) return k;
+		return M - 1;
+	}
+};
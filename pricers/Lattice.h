@@ -0,0 +1,172 @@
+#pragma once
+#include "BSModel.h"
+
+enum latticeType {
+	CRR, LeisenReimer, Trinomial
+};
+
+// Binomial (Cox-Ross-Rubinstein, Leisen-Reimer) and trinomial (Boyle) lattices for vanilla payoffs max(0, w (S - K))
+// on the first underlyer of the model's option, with drift and vol of the model
+// Only one time slice is kept: the values of step i overwrite those of step i + 1 in place, lowest node first,
+// so memory is O(steps) per strike and the backward induction is a SIMD loop across the nodes of the slice
+// American options may be exercised at every step, Bermudan ones at the first step on or after each of
+// exerciseDates dates equally spaced over the tenor; other styles are held to maturity
+// CRR and trinomial lattices do not depend on the strike, and CalculateStrikes values all strikes in one sweep
+// sharing the node spots; Leisen-Reimer centres its lattice on the strike (steps rounded up to odd) and
+// sweeps each strike on its own
+class LatticeEngine
+{
+public:
+	latticeType type = CRR;
+	unsigned int steps = 500;
+	unsigned int exerciseDates = 50;	// Bermudan style only
+
+	explicit LatticeEngine(BSModel& model) : model(model) {}
+
+	// Sets the option premium and the model's delta, gamma and theta (per year of calendar time, as CalculatePDE)
+	// PricingError is 0, discretisation error is controlled by steps
+	void Calculate()
+	{
+		Option* option = model._option;
+		const double K = option->strike;
+		double premium;
+		Sweep(&K, 1, &premium, true);
+		option->setPremium(premium);
+		model.PricingError = 0.0;
+		model.PathsUsed = 0;
+
+		// Greeks from the first slices: three nodes around the spot at step 2 (binomial) or 1 (trinomial)
+		const bool trinomial = type == Trinomial;
+		const double S0 = option->underlyers.front().Price();
+		const double* S = saved[trinomial ? 1 : 2].spot;
+		const double* V = saved[trinomial ? 1 : 2].value;
+		const double delta = trinomial ? (V[2] - V[0]) / (S[2] - S[0])
+			: (saved[1].value[1] - saved[1].value[0]) / (saved[1].spot[1] - saved[1].spot[0]);
+		const double gamma = ((V[2] - V[1]) / (S[2] - S[1]) - (V[1] - V[0]) / (S[1] - S[0])) / (0.5 * (S[2] - S[0]));
+		// the middle node is S0 on CRR and trinomial lattices only, Leisen-Reimer is brought back to S0 by a Taylor step
+		const double dS = S[1] - S0;
+		model.delta = delta;
+		model.gamma = gamma;
+		model.theta = (V[1] - premium - delta * dS - 0.5 * gamma * dS * dS) / ((trinomial ? 1 : 2) * dt);
+	}
+
+	// Prices of the option at each strike into prices, the option's own strike is ignored and its premium untouched
+	void CalculateStrikes(const vector<double>& strikes, vector<double>& prices)
+	{
+		prices.resize(strikes.size());
+		if (type == LeisenReimer)
+			for (size_t k = 0; k < strikes.size(); k++) Sweep(&strikes[k], 1, &prices[k], false);
+		else if (!strikes.empty()) Sweep(strikes.data(), strikes.size(), prices.data(), false);
+	}
+
+private:
+	struct Slice { double spot[3] = {}, value[3] = {}; };
+
+	BSModel& model;
+	Simd::aligned_vector<double> spot, values;	// node spots of the current slice, then one row per strike
+	Slice saved[3];								// first nodes of the slices at steps 0, 1 and 2 of the last Calculate
+	double dt = 0.0;
+
+	// Leisen-Reimer inversion of the normal distribution on n (odd) steps, Peizer-Pratt method 2
+	static double PeizerPratt(double z, double n)
+	{
+		const double a = z / (n + 1.0 / 3.0 + 0.1 / (n + 1.0));
+		return 0.5 + copysign(0.5 * sqrt(1.0 - exp(-a * a * (n + 1.0 / 6.0))), z);
+	}
+
+	// Whether step i (0 <= i < n) is an exercise step
+	bool Exercisable(unsigned long long i, unsigned long long n, optionStyle style) const
+	{
+		if (style == American) return true;
+		if (style != Bermudan || i == 0) return false;
+		const unsigned long long D = exerciseDates;
+		return i * D / n != (i - 1) * D / n;
+	}
+
+	// Backward induction from maturity to the root for count strikes on the lattice of the option's spot and tenor,
+	// the lattice of the first strike for Leisen-Reimer
+	void Sweep(const double* K, size_t count, double* out, bool keepSlices)
+	{
+		using namespace Simd;
+		Option* option = model._option;
+		const double S0 = option->underlyers.front().Price(), T = option->tenor, r = option->r;
+		const double mu = model.drift, vol = model.sigma;
+		if (!(S0 > 0.0) || !(T > 0.0) || !(vol > 0.0) || steps < 2)
+			throw invalid_argument("LatticeEngine: spot, maturity and vol must be positive and steps at least 2");
+		const optionStyle style = option->getStyle();
+		if (style == Asian) throw invalid_argument("LatticeEngine: no lattice for Asian options");
+		const bool trinomial = type == Trinomial;
+		const unsigned int n = type == LeisenReimer ? steps | 1u : steps;
+
+		// node spots S0 up^j down^(i - j) (binomial), S0 up^(j - i) (trinomial), and branch probabilities
+		dt = T / n;
+		const double growth = exp(mu * dt), discount = exp(-r * dt);
+		double up, down, pu, pm = 0.0, pd;
+		if (type == CRR)
+		{
+			up = exp(vol * sqrt(dt));
+			down = 1.0 / up;
+			pu = (growth - down) / (up - down);
+		}
+		else if (type == LeisenReimer)
+		{
+			const double d1 = (log(S0 / K[0]) + (mu + 0.5 * vol * vol) * T) / (vol * sqrt(T)), d2 = d1 - vol * sqrt(T);
+			pu = PeizerPratt(d2, n);
+			up = growth * PeizerPratt(d1, n) / pu;
+			down = (growth - pu * up) / (1.0 - pu);
+		}
+		else
+		{
+			const double e = exp(vol * sqrt(0.5 * dt)), g = exp(0.5 * mu * dt);
+			pu = pow((g - 1.0 / e) / (e - 1.0 / e), 2.0);
+			pd = pow((e - g) / (e - 1.0 / e), 2.0);
+			pm = 1.0 - pu - pd;
+			up = e * e;
+			down = 1.0 / up;
+		}
+		if (!trinomial) pd = 1.0 - pu;
+		if (!(pu >= 0.0 && pd >= 0.0 && pm >= 0.0))
+			throw invalid_argument("LatticeEngine: too few steps for the drift and vol, branch probabilities are negative");
+
+		// rows padded so the last SIMD block of a slice and the nodes above it reads stay in the row
+		const size_t nodes = trinomial ? 2 * size_t(n) + 1 : size_t(n) + 1;
+		const size_t stride = (nodes + width - 1) / width * width + width;
+		spot.assign(stride, 0.0);
+		values.resize(count * stride);
+		for (size_t j = 0; j < nodes; j++)
+			spot[j] = trinomial ? S0 * pow(up, double(j) - double(n)) : S0 * pow(up, double(j)) * pow(down, double(n - j));
+		const double w = option->isCall ? 1.0 : -1.0;
+		for (size_t k = 0; k < count; k++)
+			for (size_t j = 0; j < stride; j++) values[k * stride + j] = max(0.0, w * (spot[j] - K[k]));
+
+		// one step back multiplies the spot of node j by 1 / down (binomial) or up (trinomial)
+		const vdouble back = set1(trinomial ? up : 1.0 / down), sign = set1(w);
+		const vdouble qu = set1(discount * pu), qm = set1(discount * pm), qd = set1(discount * pd);
+		for (unsigned int i = n; i-- > 0;)
+		{
+			const size_t live = trinomial ? 2 * size_t(i) + 1 : size_t(i) + 1;
+			for (size_t j = 0; j < live; j += width) store(&spot[j], load(&spot[j]) * back);
+			const bool exercise = Exercisable(i, n, style);
+			for (size_t k = 0; k < count; k++)
+			{
+				// node j of slice i reads nodes j.. of slice i + 1, none of which a lower block has overwritten
+				double* V = &values[k * stride];
+				const vdouble strike = set1(K[k]);
+				for (size_t j = 0; j < live; j += width)
+				{
+					vdouble c = trinomial ? fma(qu, loadu(V + j + 2), fma(qm, loadu(V + j + 1), qd * load(V + j)))
+						: fma(qu, loadu(V + j + 1), qd * load(V + j));
+					if (exercise) c = max(c, sign * (load(&spot[j]) - strike));
+					store(V + j, c);
+				}
+			}
+			if (keepSlices && i <= 2)
+				for (size_t j = 0; j < min(live, size_t(3)); j++)
+				{
+					saved[i].spot[j] = spot[j];
+					saved[i].value[j] = values[j];
+				}
+		}
+		for (size_t k = 0; k < count; k++) out[k] = values[k * stride];
+	}
+};
@@ -0,0 +1,39 @@
+#pragma once
+#include <cmath>
+
+// Running mean and sum of squared deviations of a Monte Carlo sample (Welford)
+// Workers keep their own copy and the results are combined with merge() (Chan, Golub & LeVeque),
+// which avoids the cancellation in E[H^2] - E[H]^2 when the payoff mean is large
+struct MCStatistics
+{
+	double count = 0.0;
+	double mean = 0.0;
+	double M2 = 0.0;
+
+	void push(double x)
+	{
+		count += 1.0;
+		double d = x - mean;
+		mean += d / count;
+		M2 += d * (x - mean);
+	}
+
+	void merge(const MCStatistics& other)
+	{
+		if (other.count == 0.0) return;
+		if (count == 0.0) { *this = other; return; }
+		double n = count + other.count;
+		double d = other.mean - mean;
+		mean += d * other.count / n;
+		M2 += other.M2 + d * d * count * other.count / n;
+		count = n;
+	}
+
+	void reset() { count = mean = M2 = 0.0; }
+
+	// population variance, same convention as Hsq - H * H in the original estimator
+	double variance() const { return count > 0.0 ? M2 / count : 0.0; }
+
+	// standard error of the mean
+	double stdError() const { return count > 1.0 ? sqrt(variance() / (count - 1.0)) : 0.0; }
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include <memory>
+#include "model.h"
+#include "PathBlock.h"
+#include "../math_library/sobol.h"
+#include "../math_library/brownianbridge.h"
+#include "../math_library/AAD/AAD.h"
+
+// Scratch memory of one MC worker thread, owned by the model and kept across calls
+// Buffers are sized once per run and only ever grow, so once a mesh has been priced
+// the per-path loop of the MC engines performs no heap allocation
+struct MCWorkspace
+{
+	SamplePath path;			// current path, passed to Option::Payoff
+	vector<double> z, w;		// Gaussian draws, before and after the Brownian bridge
+	vector<double> chunkZ;		// Gaussians of a whole chunk, [path][step], for moment matching
+	PathBlock block;			// SIMD path block and its payoffs
+	vector<double> h, heps;
+	PayoffScratch payoffScratch;	// temporaries of Option::PayoffBlock
+	vector<Number> pathAAD;		// current path on the tape, AAD Monte Carlo
+	unique_ptr<Sobol> sobol;
+	unique_ptr<BrownianBridge> bridge;
+
+	void Prepare(unsigned int mesh)
+	{
+		path.resize(mesh);
+		z.resize(mesh);
+		w.resize(mesh);
+	}
+
+	// Direction numbers and bridge weights are rebuilt only when the mesh or the seed changes
+	void PrepareQuasiRandom(unsigned int mesh, unsigned long long seed)
+	{
+		if (!sobol || sobol->dim() != mesh || sobolSeed != seed)
+		{
+			sobol = make_unique<Sobol>(mesh, seed);
+			sobolSeed = seed;
+		}
+		if (!bridge || bridge->steps() != mesh)
+			bridge = make_unique<BrownianBridge>(mesh);
+	}
+
+	void PrepareBlock(unsigned int mesh, unsigned int paths)
+	{
+		block.resize(mesh, paths);
+		h.resize(block.paths());
+		heps.resize(block.paths());
+	}
+
+private:
+	unsigned long long sobolSeed = 0;
+};
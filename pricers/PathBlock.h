@@ -0,0 +1,53 @@
+#pragma once
+#include <vector>
+#include "../math_library/simd.h"
+
+// A block of Monte Carlo paths in structure-of-arrays layout:
+// row k holds step k of every path, rows are contiguous and 64-byte aligned,
+// so kernels run across paths with aligned full-width loads
+class PathBlock
+{
+public:
+	PathBlock(size_t steps = 0, size_t paths = 0) { resize(steps, paths); }
+
+	// paths is rounded up to a whole number of cache lines
+	void resize(size_t steps, size_t paths)
+	{
+		const size_t lane = Simd::alignment / sizeof(double);
+		_steps = steps;
+		_paths = (paths + lane - 1) / lane * lane;
+		if (_data.size() < _steps * _paths) _data.resize(_steps * _paths);
+	}
+
+	size_t steps() const { return _steps; }
+	size_t paths() const { return _paths; }
+
+	double* row(size_t k) { return _data.data() + k * _paths; }
+	const double* row(size_t k) const { return _data.data() + k * _paths; }
+	double* data() { return _data.data(); }
+	const double* data() const { return _data.data(); }
+
+	double operator()(size_t k, size_t p) const { return _data[k * _paths + p]; }
+
+	void Rescale(double x)
+	{
+		const Simd::vdouble vx = Simd::set1(x);
+		double* d = _data.data();
+		for (size_t i = 0; i < _steps * _paths; i += Simd::width)
+			Simd::store(d + i, Simd::load(d + i) * vx);
+	}
+
+private:
+	size_t _steps = 0, _paths = 0;
+	Simd::aligned_vector<double> _data;
+};
+
+// Scratch memory of Option::PayoffBlock, owned by the caller, one per worker thread (see MCWorkspace)
+// Buffers only ever grow, so payoffs of blocks of a given size do not allocate once they have been evaluated
+struct PayoffScratch
+{
+	std::vector<double> path;					// one path copied out of the block
+	Simd::aligned_vector<double> registers;		// operand rows of a PayoffProgram
+	std::vector<std::vector<double>> legs;		// payoffs of the second legs of combined options, per nesting level
+	size_t depth = 0;							// nesting level of the current call
+};
@@ -0,0 +1,369 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Storage of the paths kept by CalculateMC(storeSamples = true)
+// Paths are indexed in generation order, each of Mesh() steps, and written once from any worker thread
+
+// Parameters the stored paths were generated with
+struct PathStoreInfo
+{
+	uint64_t mesh = 0;
+	uint64_t seed = 0;
+	double maturity = 0.0;
+	double spot = 0.0;
+	double drift = 0.0;
+	double sigma = 0.0;
+};
+
+class PathStore
+{
+public:
+	virtual ~PathStore() {}
+
+	// Makes room for numPaths more paths generated with info and returns the index of the first one
+	// Paths of a different mesh are dropped
+	virtual size_t Append(const PathStoreInfo& info, size_t numPaths) = 0;
+
+	// Stores path i (Mesh() values), thread safe for distinct i
+	virtual void Write(size_t i, const double* S) = 0;
+
+	// Copies paths [first, first + count) into out, [path][step]
+	// Throws out_of_range if the range goes past Paths()
+	virtual void Read(size_t first, size_t count, double* out) const = 0;
+
+	// Called once all the paths of a run are written
+	virtual void Flush() {}
+
+	size_t Paths() const { return _paths; }
+	unsigned int Mesh() const { return unsigned(_info.mesh); }
+	const PathStoreInfo& Info() const { return _info; }
+
+protected:
+	PathStoreInfo _info;
+	size_t _paths = 0;
+
+	void CheckRange(size_t first, size_t count) const
+	{
+		if (first > _paths || count > _paths - first)
+			throw out_of_range("PathStore: paths [" + to_string(first) + ", " + to_string(first + count)
+				+ ") past the " + to_string(_paths) + " stored");
+	}
+};
+
+// In memory, contiguous [path][step]
+class MemoryPathStore : public PathStore
+{
+public:
+	size_t Append(const PathStoreInfo& info, size_t numPaths)
+	{
+		if (info.mesh != _info.mesh) { _data.clear(); _paths = 0; }
+		_info = info;
+		size_t first = _paths;
+		_paths += numPaths;
+		_data.resize(_paths * _info.mesh);
+		return first;
+	}
+
+	void Write(size_t i, const double* S)
+	{
+		memcpy(_data.data() + i * _info.mesh, S, _info.mesh * sizeof(double));
+	}
+
+	void Read(size_t first, size_t count, double* out) const
+	{
+		CheckRange(first, count);
+		memcpy(out, Path(first), count * _info.mesh * sizeof(double));
+	}
+
+	const double* Path(size_t i) const { return _data.data() + i * _info.mesh; }
+
+private:
+	vector<double> _data;
+};
+
+// Memory-mapped binary file:
+//     a 4096-byte header (PathStoreFileHeader), then the paths as a dense [path][step] matrix of float64 or float32
+// Writes stream through windows of chunkPaths paths that are mapped on first use and unmapped
+// as soon as all their paths are written, so resident memory stays bounded whatever the number of paths
+// Read maps only the requested range
+class MappedPathStore : public PathStore
+{
+public:
+	struct PathStoreFileHeader
+	{
+		char magic[8];
+		uint32_t version;
+		uint32_t valueBytes;	// 8: float64, 4: float32
+		uint64_t chunkPaths;
+		uint64_t numPaths;
+		PathStoreInfo info;
+	};
+	static constexpr size_t dataOffset = 4096;
+
+	// Creates (or truncates) file
+	MappedPathStore(const string& file, bool useFloat32 = false, size_t chunkPaths = 1024)
+		: _valueBytes(useFloat32 ? 4 : 8), _chunkPaths(chunkPaths)
+	{
+		OpenFile(file, true);
+		ResizeFile(dataOffset);
+		WriteHeader();
+	}
+
+	// Opens an existing file, to read it or append to it
+	static shared_ptr<MappedPathStore> Open(const string& file)
+	{
+		shared_ptr<MappedPathStore> store(new MappedPathStore());
+		store->OpenFile(file, false);
+		Mapping head = store->Map(0, sizeof(PathStoreFileHeader), false);
+		PathStoreFileHeader header;
+		memcpy(&header, head.data, sizeof(header));
+		store->Unmap(head);
+		if (memcmp(header.magic, "QLPATHS", 8) != 0 || header.version != 1)
+			throw runtime_error("MappedPathStore: " + file + " is not a path store");
+		store->_valueBytes = header.valueBytes;
+		store->_chunkPaths = header.chunkPaths;
+		store->_paths = header.numPaths;
+		store->_info = header.info;
+		return store;
+	}
+
+	~MappedPathStore()
+	{
+		Flush();
+		CloseFile();
+	}
+
+	size_t Append(const PathStoreInfo& info, size_t numPaths)
+	{
+		Flush();
+		// windows were unmapped by Flush, the written counts of the old paths go with them
+		if (info.mesh != _info.mesh) { _chunks.clear(); _paths = 0; }
+		_info = info;
+		size_t first = _paths;
+		_paths += numPaths;
+		ResizeFile(dataOffset + _paths * PathBytes());
+		_chunks.resize((_paths + _chunkPaths - 1) / _chunkPaths);
+		for (auto& c : _chunks)
+			if (!c) c = make_unique<Chunk>();
+		WriteHeader();
+		return first;
+	}
+
+	void Write(size_t i, const double* S)
+	{
+		Chunk& chunk = *_chunks[i / _chunkPaths];
+		char* base = chunk.data.load(memory_order_acquire);
+		if (!base)
+		{
+			lock_guard<mutex> lock(_mutex);
+			base = chunk.data.load(memory_order_relaxed);
+			if (!base)
+			{
+				size_t first = i / _chunkPaths * _chunkPaths;
+				chunk.mapping = Map(dataOffset + first * PathBytes(), min(_chunkPaths, _paths - first) * PathBytes(), true);
+				base = chunk.mapping.data;
+				chunk.data.store(base, memory_order_release);
+			}
+		}
+		Encode(S, base + (i % _chunkPaths) * PathBytes());
+
+		// last path of a full chunk: release the window
+		if (++chunk.written == _chunkPaths)
+		{
+			lock_guard<mutex> lock(_mutex);
+			Unmap(chunk.mapping);
+			chunk.data.store(nullptr, memory_order_release);
+		}
+	}
+
+	void Read(size_t first, size_t count, double* out) const
+	{
+		CheckRange(first, count);
+		if (!count) return;
+		Mapping m = Map(dataOffset + first * PathBytes(), count * PathBytes(), false);
+		for (size_t p = 0; p < count; p++)
+			Decode(m.data + p * PathBytes(), out + p * _info.mesh);
+		Unmap(m);
+	}
+
+	// Unmaps the windows of partially written chunks and updates the header
+	void Flush()
+	{
+		lock_guard<mutex> lock(_mutex);
+		for (auto& c : _chunks)
+		{
+			if (c && c->data.load())
+			{
+				Unmap(c->mapping);
+				c->data.store(nullptr);
+			}
+		}
+	}
+
+	bool IsFloat32() const { return _valueBytes == 4; }
+
+private:
+	struct Mapping
+	{
+		void* base = nullptr;	// page aligned start of the view
+		size_t length = 0;
+		char* data = nullptr;	// requested offset
+	};
+
+	struct Chunk
+	{
+		atomic<char*> data{ nullptr };
+		atomic<size_t> written{ 0 };
+		Mapping mapping;
+	};
+
+	MappedPathStore() {}
+
+	size_t PathBytes() const { return _info.mesh * _valueBytes; }
+
+	void Encode(const double* S, char* dest) const
+	{
+		if (_valueBytes == 8) { memcpy(dest, S, PathBytes()); return; }
+		for (size_t k = 0; k < _info.mesh; k++)
+		{
+			float x = float(S[k]);
+			memcpy(dest + k * 4, &x, 4);
+		}
+	}
+
+	void Decode(const char* src, double* S) const
+	{
+		if (_valueBytes == 8) { memcpy(S, src, PathBytes()); return; }
+		for (size_t k = 0; k < _info.mesh; k++)
+		{
+			float x;
+			memcpy(&x, src + k * 4, 4);
+			S[k] = x;
+		}
+	}
+
+	void WriteHeader()
+	{
+		PathStoreFileHeader header = {};
+		memcpy(header.magic, "QLPATHS", 8);
+		header.version = 1;
+		header.valueBytes = uint32_t(_valueBytes);
+		header.chunkPaths = _chunkPaths;
+		header.numPaths = _paths;
+		header.info = _info;
+		Mapping head = Map(0, sizeof(header), true);
+		memcpy(head.data, &header, sizeof(header));
+		Unmap(head);
+	}
+
+	size_t _valueBytes = 8;
+	size_t _chunkPaths = 1024;
+	vector<unique_ptr<Chunk>> _chunks;
+	mutable mutex _mutex;
+
+	// Platform layer: open, resize, map and unmap
+
+#ifdef _WIN32
+	HANDLE _file = INVALID_HANDLE_VALUE;
+
+	void OpenFile(const string& file, bool create)
+	{
+		_file = CreateFileA(file.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+			create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (_file == INVALID_HANDLE_VALUE) throw runtime_error("MappedPathStore: cannot open " + file);
+	}
+
+	void CloseFile()
+	{
+		if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+	}
+
+	void ResizeFile(size_t size)
+	{
+		LARGE_INTEGER s;
+		s.QuadPart = LONGLONG(size);
+		if (!SetFilePointerEx(_file, s, nullptr, FILE_BEGIN) || !SetEndOfFile(_file))
+			throw runtime_error("MappedPathStore: cannot resize file");
+	}
+
+	Mapping Map(size_t offset, size_t length, bool writable) const
+	{
+		SYSTEM_INFO si;
+		GetSystemInfo(&si);
+		size_t start = offset / si.dwAllocationGranularity * si.dwAllocationGranularity;
+		HANDLE section = CreateFileMappingA(_file, nullptr, writable ? PAGE_READWRITE : PAGE_READONLY, 0, 0, nullptr);
+		if (!section) throw runtime_error("MappedPathStore: cannot map file");
+		Mapping m;
+		m.length = length + (offset - start);
+		m.base = MapViewOfFile(section, writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+			DWORD(uint64_t(start) >> 32), DWORD(start), m.length);
+		CloseHandle(section);
+		if (!m.base) throw runtime_error("MappedPathStore: cannot map file");
+		m.data = static_cast<char*>(m.base) + (offset - start);
+		return m;
+	}
+
+	void Unmap(Mapping& m) const
+	{
+		if (m.base) UnmapViewOfFile(m.base);
+		m = Mapping();
+	}
+#else
+	int _file = -1;
+
+	void OpenFile(const string& file, bool create)
+	{
+		_file = open(file.c_str(), create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDWR, 0644);
+		if (_file < 0) throw runtime_error("MappedPathStore: cannot open " + file);
+	}
+
+	void CloseFile()
+	{
+		if (_file >= 0) close(_file);
+	}
+
+	void ResizeFile(size_t size)
+	{
+		if (ftruncate(_file, off_t(size)) != 0) throw runtime_error("MappedPathStore: cannot resize file");
+	}
+
+	Mapping Map(size_t offset, size_t length, bool writable) const
+	{
+		static const size_t page = size_t(sysconf(_SC_PAGESIZE));
+		size_t start = offset / page * page;
+		Mapping m;
+		m.length = length + (offset - start);
+		m.base = mmap(nullptr, m.length, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, _file, off_t(start));
+		if (m.base == MAP_FAILED) throw runtime_error("MappedPathStore: cannot map file");
+		m.data = static_cast<char*>(m.base) + (offset - start);
+		return m;
+	}
+
+	void Unmap(Mapping& m) const
+	{
+		if (m.base) munmap(m.base, m.length);
+		m = Mapping();
+	}
+#endif
+};
@@ -0,0 +1,439 @@
+#pragma once
+#include <cctype>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "BSModel.h"
+
+// Payoff expressions compiled once into a flat stack bytecode, evaluated over whole path blocks
+//
+//     expr := sum [('>' | '<' | '>=' | '<=') sum] ; sum := prod {('+' | '-') prod}
+//     prod := unary {('*' | '/') unary} ; unary := '-' unary | number | name | S[k] | S | call | '(' expr ')'
+//
+// S[k] is the spot at path date k (negative k counts from the last date, S alone is S[-1]),
+// avg(a, b), pathmax(a, b) and pathmin(a, b) run over dates a..b (all dates without arguments),
+// max(x, y, ...), min(x, y, ...) and abs(x) are pointwise, comparisons give 1 or 0 (barrier indicators)
+// and names are the parameters given to Compile. For example, with K, K2, B as parameters:
+//     max(S - K, 0) - max(S - K2, 0)          call spread (DifferenceOfOptions of two calls)
+//     max(avg() - K, 0)                       arithmetic Asian call
+//     max(S - K, 0) * (pathmax() < B)         up-and-out call
+//
+// Constant subexpressions are folded and constant operands become immediates of the instruction using them.
+// Each instruction then runs across all the paths of a block with SIMD loops, spot dates are read in place
+// and the last instruction writes the payoffs, so the interpretation cost is paid once per instruction and block
+class PayoffProgram
+{
+public:
+	enum opCode { Const, Spot, Average, PathMax, PathMin, Add, Sub, Mul, Div, Neg, Max, Min, Abs, Greater, Less, GreaterEq, LessEq };
+	enum operandMode { StackOperands, ImmediateRight, ImmediateLeft };
+
+	struct Instruction
+	{
+		opCode op;
+		operandMode operands = StackOperands;	// binary operations, one operand may be value
+		double value = 0.0;			// Const and immediates
+		int first = 0, last = -1;		// Spot (first), Average, PathMax, PathMin
+	};
+
+	PayoffProgram() {}
+
+	// Parses script, throws invalid_argument with the offending position
+	static PayoffProgram Compile(const string& script, const map<string, double>& parameters = {})
+	{
+		PayoffProgram program;
+		Parser parser{ script, parameters, 0, program };
+		parser.Expression();
+		parser.SkipSpaces();
+		if (parser.pos != script.size()) parser.Fail("unexpected character");
+		return program;
+	}
+
+	const vector<Instruction>& Code() const { return code; }
+
+	// Payoff of one path
+	double Evaluate(const double* S, size_t steps) const
+	{
+		double stack[maxStack];
+		int sp = 0;
+		for (const Instruction& in : code)
+		{
+			switch (in.op)
+			{
+			case Const: stack[sp++] = in.value; break;
+			case Spot: stack[sp++] = S[Date(in.first, steps)]; break;
+			case Average:
+			case PathMax:
+			case PathMin:
+			{
+				const size_t a = Date(in.first, steps), b = Date(in.last, steps);
+				double x = S[a];
+				for (size_t k = a + 1; k <= b; k++)
+					x = in.op == Average ? x + S[k] : in.op == PathMax ? max(x, S[k]) : min(x, S[k]);
+				stack[sp++] = in.op == Average ? x * (1.0 / double(b - a + 1)) : x;
+				break;
+			}
+			case Neg: stack[sp - 1] = -stack[sp - 1]; break;
+			case Abs: stack[sp - 1] = abs(stack[sp - 1]); break;
+			default:
+				if (in.operands == ImmediateRight) stack[sp - 1] = Apply(in.op, stack[sp - 1], in.value);
+				else if (in.operands == ImmediateLeft) stack[sp - 1] = Apply(in.op, in.value, stack[sp - 1]);
+				else
+				{
+					sp--;
+					stack[sp - 1] = Apply(in.op, stack[sp - 1], stack[sp]);
+				}
+			}
+		}
+		return stack[0];
+	}
+
+	// Payoffs of all the paths of block into out[0..block.paths()-1]
+	// scratch is grown to the program's stack and may be kept across calls, one per thread
+	void Evaluate(const PathBlock& block, double* out, Simd::aligned_vector<double>& scratch) const
+	{
+		using namespace Simd;
+		const size_t n = block.paths(), steps = block.steps();
+		if (scratch.size() < depth * n) scratch.resize(depth * n);
+		// operand slots point at scratch rows, straight at block rows for spot dates, or at out for the result
+		const double* slot[maxStack];
+		int sp = 0;
+		for (size_t i = 0; i < code.size(); i++)
+		{
+			const Instruction& in = code[i];
+			const bool binary = in.op >= Add && in.op != Neg && in.op != Abs;
+			const int result = in.op <= PathMin ? sp : binary && in.operands == StackOperands ? sp - 2 : sp - 1;
+			double* dst = i + 1 == code.size() ? out : scratch.data() + result * n;
+			const double* value = dst;
+			switch (in.op)
+			{
+			case Const:
+			{
+				const vdouble c = set1(in.value);
+				for (size_t p = 0; p < n; p += width) storeu(dst + p, c);
+				break;
+			}
+			case Spot: value = block.row(Date(in.first, steps)); break;
+			case Average:
+			case PathMax:
+			case PathMin:
+			{
+				const size_t a = Date(in.first, steps), b = Date(in.last, steps);
+				const vdouble scale = set1(in.op == Average ? 1.0 / double(b - a + 1) : 1.0);
+				for (size_t p = 0; p < n; p += width)
+				{
+					vdouble x = load(block.row(a) + p);
+					for (size_t k = a + 1; k <= b; k++)
+					{
+						const vdouble y = load(block.row(k) + p);
+						x = in.op == Average ? x + y : in.op == PathMax ? Simd::max(x, y) : Simd::min(x, y);
+					}
+					storeu(dst + p, x * scale);
+				}
+				break;
+			}
+			case Neg:
+			case Abs:
+			{
+				const double* x = slot[result];
+				for (size_t p = 0; p < n; p += width)
+					storeu(dst + p, in.op == Neg ? -loadu(x + p) : Simd::abs(loadu(x + p)));
+				break;
+			}
+			default:
+				BinaryKernel(in, n, dst, slot[result], in.operands == StackOperands ? slot[result + 1] : nullptr);
+			}
+			slot[result] = value;
+			sp = result + 1;
+		}
+		if (slot[0] != out)
+			for (size_t p = 0; p < n; p += width) storeu(out + p, loadu(slot[0] + p));
+	}
+
+private:
+	static constexpr int maxStack = 64;
+	vector<Instruction> code;
+	int depth = 0;		// deepest stack the program reaches
+	int stack = 0;		// stack height while compiling
+
+	// Binary operations, on doubles or SIMD registers
+	template <class V>
+	static V Apply(opCode op, const V& x, const V& y)
+	{
+		using namespace Simd;
+		switch (op)
+		{
+		case Add: return x + y;
+		case Sub: return x - y;
+		case Mul: return x * y;
+		case Div: return x / y;
+		case Max: return max(x, y);
+		case Min: return min(x, y);
+		case Greater: return Indicator(x > y);
+		case Less: return Indicator(x < y);
+		case GreaterEq: return Indicator(x > y || x == y);
+		case LessEq: return Indicator(x < y || x == y);
+		default: throw logic_error("PayoffProgram: not a binary operation");
+		}
+	}
+	static double Indicator(bool b) { return b ? 1.0 : 0.0; }
+	static Simd::vdouble Indicator(Simd::vmask m) { return Simd::select(m, Simd::set1(1.0), Simd::set1(0.0)); }
+
+	// y = x1 op x2 over n paths, x2 unused with an immediate; the dispatch is hoisted out of the loops
+	static void BinaryKernel(const Instruction& in, size_t n, double* y, const double* x1, const double* x2)
+	{
+		using namespace Simd;
+		auto loop = [&](auto f) {
+			const vdouble c = set1(in.value);
+			if (in.operands == ImmediateRight) for (size_t p = 0; p < n; p += width) storeu(y + p, f(loadu(x1 + p), c));
+			else if (in.operands == ImmediateLeft) for (size_t p = 0; p < n; p += width) storeu(y + p, f(c, loadu(x1 + p)));
+			else for (size_t p = 0; p < n; p += width) storeu(y + p, f(loadu(x1 + p), loadu(x2 + p)));
+		};
+		switch (in.op)
+		{
+		case Add: loop([](vdouble a, vdouble b) { return a + b; }); break;
+		case Sub: loop([](vdouble a, vdouble b) { return a - b; }); break;
+		case Mul: loop([](vdouble a, vdouble b) { return a * b; }); break;
+		case Div: loop([](vdouble a, vdouble b) { return a / b; }); break;
+		case Max: loop([](vdouble a, vdouble b) { return Simd::max(a, b); }); break;
+		case Min: loop([](vdouble a, vdouble b) { return Simd::min(a, b); }); break;
+		case Greater: loop([](vdouble a, vdouble b) { return Indicator(a > b); }); break;
+		case Less: loop([](vdouble a, vdouble b) { return Indicator(a < b); }); break;
+		case GreaterEq: loop([](vdouble a, vdouble b) { return Indicator(a > b || a == b); }); break;
+		case LessEq: loop([](vdouble a, vdouble b) { return Indicator(a < b || a == b); }); break;
+		default: throw logic_error("PayoffProgram: not a binary operation");
+		}
+	}
+
+	static size_t Date(int k, size_t steps)
+	{
+		const long long d = k < 0 ? (long long)steps + k : k;
+		if (d < 0 || d >= (long long)steps) throw out_of_range("PayoffProgram: path date " + to_string(k) + " outside the path");
+		return size_t(d);
+	}
+
+	void Emit(const Instruction& in, int stackChange)
+	{
+		code.push_back(in);
+		stack += stackChange;
+		depth = max(depth, stack);
+		if (depth > maxStack) throw invalid_argument("PayoffProgram: expression too deep");
+	}
+
+	// Binary operation on the operands compiled into code[left..right-1] and code[right..]
+	// Constant operands are folded into a Const or an immediate
+	void EmitBinary(opCode op, size_t left, size_t right)
+	{
+		const bool constLeft = right == left + 1 && code[left].op == Const;
+		const bool constRight = code.size() == right + 1 && code[right].op == Const;
+		Instruction in;
+		in.op = op;
+		if (constLeft && constRight)
+		{
+			code[left].value = Apply(op, code[left].value, code[right].value);
+			code.pop_back();
+		}
+		else if (constRight)
+		{
+			in.operands = ImmediateRight;
+			in.value = code[right].value;
+			code.back() = in;
+		}
+		else if (constLeft)
+		{
+			in.operands = ImmediateLeft;
+			in.value = code[left].value;
+			code.erase(code.begin() + left);
+			code.push_back(in);
+		}
+		else code.push_back(in);
+		stack--;
+	}
+
+	// Recursive descent, one instruction per operation in evaluation order
+	struct Parser
+	{
+		const string& text;
+		const map<string, double>& parameters;
+		size_t pos;
+		PayoffProgram& program;
+
+		[[noreturn]] void Fail(const string& what)
+		{
+			throw invalid_argument("PayoffProgram: " + what + " at position " + to_string(pos) + " in \"" + text + "\"");
+		}
+
+		void SkipSpaces() { while (pos < text.size() && isspace((unsigned char)text[pos])) pos++; }
+
+		bool Accept(const char* token)
+		{
+			SkipSpaces();
+			const size_t n = char_traits<char>::length(token);
+			if (text.compare(pos, n, token) != 0) return false;
+			pos += n;
+			return true;
+		}
+
+		void Expect(const char* token) { if (!Accept(token)) Fail(string("expected '") + token + "'"); }
+
+		size_t Here() const { return program.code.size(); }
+
+		void Expression()
+		{
+			const size_t left = Here();
+			Sum();
+			const size_t right = Here();
+			opCode op;
+			if (Accept(">=")) op = GreaterEq;
+			else if (Accept("<=")) op = LessEq;
+			else if (Accept(">")) op = Greater;
+			else if (Accept("<")) op = Less;
+			else return;
+			Sum();
+			program.EmitBinary(op, left, right);
+		}
+
+		void Sum()
+		{
+			const size_t left = Here();
+			Product();
+			for (;;)
+			{
+				const size_t right = Here();
+				if (Accept("+")) { Product(); program.EmitBinary(Add, left, right); }
+				else if (Accept("-")) { Product(); program.EmitBinary(Sub, left, right); }
+				else return;
+			}
+		}
+
+		void Product()
+		{
+			const size_t left = Here();
+			Unary();
+			for (;;)
+			{
+				const size_t right = Here();
+				if (Accept("*")) { Unary(); program.EmitBinary(Mul, left, right); }
+				else if (Accept("/")) { Unary(); program.EmitBinary(Div, left, right); }
+				else return;
+			}
+		}
+
+		int Integer()
+		{
+			SkipSpaces();
+			const size_t start = pos;
+			if (pos < text.size() && text[pos] == '-') pos++;
+			while (pos < text.size() && isdigit((unsigned char)text[pos])) pos++;
+			if (pos == start || (pos == start + 1 && text[start] == '-')) Fail("expected a path date");
+			return stoi(text.substr(start, pos - start));
+		}
+
+		void Unary()
+		{
+			Instruction in;
+			if (Accept("-"))
+			{
+				const size_t operand = Here();
+				Unary();
+				if (Here() == operand + 1 && program.code[operand].op == Const) program.code[operand].value = -program.code[operand].value;
+				else
+				{
+					in.op = Neg;
+					program.Emit(in, 0);
+				}
+				return;
+			}
+			if (Accept("(")) { Expression(); Expect(")"); return; }
+			SkipSpaces();
+			if (pos < text.size() && (isdigit((unsigned char)text[pos]) || text[pos] == '.'))
+			{
+				size_t used = 0;
+				in.op = Const;
+				in.value = stod(text.substr(pos), &used);
+				pos += used;
+				program.Emit(in, 1);
+				return;
+			}
+			const size_t start = pos;
+			while (pos < text.size() && (isalnum((unsigned char)text[pos]) || text[pos] == '_')) pos++;
+			const string name = text.substr(start, pos - start);
+			if (name.empty()) Fail("expected a value");
+
+			if (name == "S")
+			{
+				in.op = Spot;
+				in.first = -1;
+				if (Accept("[")) { in.first = Integer(); Expect("]"); }
+				program.Emit(in, 1);
+			}
+			else if (name == "avg" || name == "pathmax" || name == "pathmin")
+			{
+				in.op = name == "avg" ? Average : name == "pathmax" ? PathMax : PathMin;
+				in.first = 0;
+				in.last = -1;
+				Expect("(");
+				if (!Accept(")"))
+				{
+					in.first = Integer();
+					Expect(",");
+					in.last = Integer();
+					Expect(")");
+				}
+				program.Emit(in, 1);
+			}
+			else if (name == "max" || name == "min")
+			{
+				Expect("(");
+				const size_t left = Here();
+				Expression();
+				int args = 1;
+				for (size_t right = Here(); Accept(","); right = Here(), args++)
+				{
+					Expression();
+					program.EmitBinary(name == "max" ? Max : Min, left, right);
+				}
+				Expect(")");
+				if (args < 2) Fail(name + " needs at least two arguments");
+			}
+			else if (name == "abs")
+			{
+				Expect("(");
+				Expression();
+				Expect(")");
+				in.op = Abs;
+				program.Emit(in, 0);
+			}
+			else
+			{
+				auto it = parameters.find(name);
+				if (it == parameters.end()) Fail("unknown name '" + name + "'");
+				in.op = Const;
+				in.value = it->second;
+				program.Emit(in, 1);
+			}
+		}
+	};
+};
+
+namespace Derivatives {
+	// Option whose payoff is a PayoffProgram, e.g. loaded from configuration
+	class ScriptedOption : public Option {
+	public:
+		ScriptedOption(vector<Asset> underlyer, const string& script, const map<string, double>& parameters = {},
+			double _t = 0, double _m = 0, double _r = 0, double _iv = 0) :
+			Option(underlyer, European, true, 0.0, _t, _m, _r, _iv), program(PayoffProgram::Compile(script, parameters)) {}
+
+		const PayoffProgram& Program() const { return program; }
+
+		double Payoff(SamplePath& S) { return program.Evaluate(S.data(), S.size()); }
+
+		void PayoffBlock(const PathBlock& block, double* out, PayoffScratch& scratch)
+		{
+			program.Evaluate(block, out, scratch.registers);
+		}
+
+	private:
+		PayoffProgram program;
+	};
+}
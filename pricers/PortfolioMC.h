@@ -0,0 +1,117 @@
+#pragma once
+#include "BSModel.h"
+
+// Monte Carlo of many trades on shared paths
+// Trades whose paths coincide (same underlyer spot, rate, implied vol and maturity) form a group,
+// each path block of a group is generated once by BSModel::GeneratePathBlock and every trade of the group
+// is evaluated on it with Option::PayoffBlock, so a 500-strike chain costs one path set plus 500 payoff kernels
+// Per trade, results are those of BSModel::CalculateMCBlock with the same seed, mesh and epsilon
+class PortfolioMC
+{
+public:
+	struct TradeResult
+	{
+		double premium = 0.0;
+		double PricingError = 0.0;
+		double delta = 0.0;
+	};
+
+	unsigned long long seed = 0;
+
+	// Trades are priced in the order they are added, options must outlive the engine
+	void Add(Option* option)
+	{
+		for (auto& g : groups)
+		{
+			if (g.spot == option->underlyers.front().Price() && g.r == option->r
+				&& g.sigma == option->impliedVol() && g.maturity == option->maturity)
+			{
+				g.trades.push_back(trades.size());
+				trades.push_back(option);
+				return;
+			}
+		}
+		Group g;
+		g.spot = option->underlyers.front().Price();
+		g.r = option->r;
+		g.sigma = option->impliedVol();
+		g.maturity = option->maturity;
+		g.trades.push_back(trades.size());
+		groups.push_back(g);
+		trades.push_back(option);
+	}
+
+	size_t Trades() const { return trades.size(); }
+	size_t Groups() const { return groups.size(); }
+
+	// Sets every trade's premium and fills Results()
+	void CalculateMC(unsigned int iteration = 10000, unsigned int mesh = 1, double epsilon = 0.0001, unsigned int numThreads = 1)
+	{
+		const unsigned int chunk = BSModel::mcChunkSize, blockSize = BSModel::pathBlockSize;
+		const unsigned int numChunks = (iteration + chunk - 1) / chunk;
+		results.assign(trades.size(), TradeResult());
+
+		for (auto& g : groups)
+		{
+			const size_t n = g.trades.size();
+			BSModel model(trades[g.trades.front()]);
+			model.seed = seed;
+
+			// [trade][chunk] accumulators, merged in chunk order as in BSModel
+			vector<vector<MCStatistics>> payoffStats(n, vector<MCStatistics>(numChunks)), bumpStats(payoffStats);
+			const unsigned int threads = max(1u, min(numThreads, numChunks));
+
+			auto worker = [&](unsigned int t) {
+				PathBlock block(mesh, blockSize);
+				vector<double> h(n * block.paths()), heps(block.paths());
+				PayoffScratch scratch;
+				for (unsigned int c = t; c < numChunks; c += threads)
+				{
+					unsigned int last = min(iteration, (c + 1) * chunk);
+					for (unsigned int first = c * chunk; first < last; first += blockSize)
+					{
+						const unsigned int count = min(blockSize, last - first);
+						model.GeneratePathBlock(model._option->maturity, mesh, first, block);
+						for (size_t j = 0; j < n; j++)
+							trades[g.trades[j]]->PayoffBlock(block, h.data() + j * block.paths(), scratch);
+						block.Rescale(1.0 + epsilon);
+						for (size_t j = 0; j < n; j++)
+						{
+							const double* hj = h.data() + j * block.paths();
+							trades[g.trades[j]]->PayoffBlock(block, heps.data(), scratch);
+							for (unsigned int p = 0; p < count; p++)
+							{
+								payoffStats[j][c].push(hj[p]);
+								bumpStats[j][c].push(heps[p] - hj[p]);
+							}
+						}
+					}
+				}
+			};
+			BSModel::RunWorkers(threads, worker);
+
+			for (size_t j = 0; j < n; j++)
+			{
+				BSModel trade(trades[g.trades[j]]);
+				trade.SetMCResults(payoffStats[j], bumpStats[j], epsilon);
+				TradeResult& res = results[g.trades[j]];
+				res.premium = trade._option->getPremium();
+				res.PricingError = trade.PricingError;
+				res.delta = trade.delta;
+			}
+		}
+	}
+
+	const vector<TradeResult>& Results() const { return results; }
+
+private:
+	struct Group
+	{
+		double spot, r, sigma, maturity;
+		vector<size_t> trades;	// indices into trades
+	};
+
+	vector<Option*> trades;
+	vector<Group> groups;
+	vector<TradeResult> results;
+};
@@ -0,0 +1,279 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <thread>
+#include <vector>
+#include "../math_library/Solver/LevenbergMarquardt.hpp"
+
+using namespace std;
+
+// Volatility surface of one underlyer, one raw SVI smile per expiry:
+//     w(k) = a + b (rho (k - m) + sqrt((k - m)^2 + sigma^2)),   w = vol^2 T total variance, k = log(K / F)
+// Calibrate fits the slices independently and in parallel (Levenberg-Marquardt, analytic Jacobian),
+// then walks the expiries in order and refits any slice whose total variance dips below the previous one
+// with a penalty on a grid over the quoted log-moneyness range, so the surface is free of calendar arbitrage there
+// The parameters of the last calibration are the initial guesses of the next one (the previous day's surface),
+// which brings a refresh down to a few iterations per slice
+
+struct SVIParameters
+{
+	double a = 0.0, b = 0.0, rho = 0.0, m = 0.0, sigma = 0.1;
+
+	double TotalVariance(double k) const
+	{
+		const double d = k - m;
+		return a + b * (rho * d + sqrt(d * d + sigma * sigma));
+	}
+
+	// Minimum of the smile, must stay non-negative
+	double MinimumVariance() const { return a + b * sigma * sqrt(1.0 - rho * rho); }
+};
+
+// Market quotes of one expiry
+struct SVISlice
+{
+	double maturity = 0.0;
+	double forward = 0.0;
+	vector<double> strikes, vols;
+	vector<double> weights;		// per quote, all 1 when empty (e.g. vegas to fit prices rather than vols)
+};
+
+class SVISurface
+{
+public:
+	unsigned int numThreads = 1;
+	double calendarPenalty = 1e3;		// weight of a unit of total variance below the previous slice
+	double calendarTolerance = 1e-8;	// total variance below the previous slice left after the refit
+	unsigned int calendarGrid = 41;		// log-moneyness points where the calendar condition is enforced
+
+	// Fits every slice; slices are sorted by maturity
+	void Calibrate(vector<SVISlice> slices)
+	{
+		sort(slices.begin(), slices.end(), [](const SVISlice& x, const SVISlice& y) { return x.maturity < y.maturity; });
+		const size_t n = slices.size();
+		vector<SVIParameters> guess(n);
+		gridLow = gridHigh = 0.0;
+		for (size_t i = 0; i < n; i++)
+		{
+			guess[i] = InitialGuess(slices[i]);
+			for (size_t j = 0; j < slices[i].strikes.size(); j++)
+			{
+				const double k = log(slices[i].strikes[j] / slices[i].forward);
+				gridLow = min(gridLow, k);
+				gridHigh = max(gridHigh, k);
+			}
+		}
+
+		fits.assign(n, Fit());
+		const unsigned int threads = max(1u, min(numThreads, unsigned(n)));
+		auto worker = [&](unsigned int t) {
+			SVISolver solver;
+			for (size_t i = t; i < n; i += threads)
+				fits[i] = FitSlice(solver, slices[i], guess[i], nullptr, calendarPenalty);
+		};
+		if (threads == 1) worker(0);
+		else
+		{
+			vector<thread> workers;
+			for (unsigned int t = 0; t < threads; t++) workers.emplace_back(worker, t);
+			for (auto& w : workers) w.join();
+		}
+
+		// calendar arbitrage: w(k, T_i) >= w(k, T_i-1) on the grid, in maturity order
+		SVISolver solver;
+		for (size_t i = 1; i < n; i++)
+		{
+			// the penalty is raised tenfold until the violation is within tolerance
+			double penalty = calendarPenalty;
+			for (int attempt = 0; attempt < 4 && CalendarViolation(fits[i - 1].parameters, fits[i].parameters) > calendarTolerance; attempt++)
+			{
+				Fit refit = FitSlice(solver, slices[i], fits[i].parameters, &fits[i - 1].parameters, penalty);
+				refit.iterations += fits[i].iterations;
+				refit.calendarRefit = true;
+				fits[i] = refit;
+				penalty *= 10.0;
+			}
+		}
+
+		maturities.resize(n);
+		for (size_t i = 0; i < n; i++) maturities[i] = slices[i].maturity;
+	}
+
+	size_t Slices() const { return fits.size(); }
+	double Maturity(size_t i) const { return maturities[i]; }
+	const SVIParameters& Parameters(size_t i) const { return fits[i].parameters; }
+	// Levenberg-Marquardt iterations of slice i in the last calibration, calendar refit included
+	unsigned int Iterations(size_t i) const { return fits[i].iterations; }
+	// Root mean square total variance error of slice i
+	double RMSError(size_t i) const { return fits[i].rmsError; }
+	bool CalendarRefit(size_t i) const { return fits[i].calendarRefit; }
+
+	// Largest amount by which the total variance of slice i + 1 falls below slice i on the grid, 0 if none
+	double CalendarViolation(size_t i) const { return CalendarViolation(fits[i].parameters, fits[i + 1].parameters); }
+
+	// Total variance at log-moneyness k, linear in maturity between slices (flat vol outside),
+	// which keeps the interpolated surface calendar arbitrage free
+	double TotalVariance(double k, double T) const
+	{
+		const size_t n = fits.size();
+		if (T <= maturities.front()) return fits.front().parameters.TotalVariance(k) * T / maturities.front();
+		if (T >= maturities.back()) return fits.back().parameters.TotalVariance(k) * T / maturities.back();
+		const size_t j = upper_bound(maturities.begin(), maturities.end(), T) - maturities.begin();
+		const double u = (T - maturities[j - 1]) / (maturities[j] - maturities[j - 1]);
+		return (1.0 - u) * fits[j - 1].parameters.TotalVariance(k) + u * fits[min(j, n - 1)].parameters.TotalVariance(k);
+	}
+
+	double ImpliedVol(double strike, double forward, double T) const
+	{
+		return sqrt(max(0.0, TotalVariance(log(strike / forward), T)) / T);
+	}
+
+private:
+	using SVISolver = SolverLib::LevenbergMarquardt<5>;
+
+	struct Fit
+	{
+		SVIParameters parameters;
+		unsigned int iterations = 0;
+		double rmsError = 0.0;
+		bool calendarRefit = false;
+	};
+
+	vector<Fit> fits;
+	vector<double> maturities;
+
+	// Grid of the calendar condition, over the quoted log-moneyness of the whole surface
+	double gridLow = 0.0, gridHigh = 0.0;
+
+	// Previous parameters of the nearest expiry, a and b rescaled with maturity as total variance is;
+	// otherwise a smile through the lowest quote with the wing slopes of the outermost quotes
+	SVIParameters InitialGuess(const SVISlice& slice) const
+	{
+		if (!fits.empty())
+		{
+			size_t nearest = 0;
+			for (size_t j = 1; j < maturities.size(); j++)
+				if (abs(maturities[j] - slice.maturity) < abs(maturities[nearest] - slice.maturity)) nearest = j;
+			SVIParameters p = fits[nearest].parameters;
+			const double scale = slice.maturity / maturities[nearest];
+			p.a *= scale;
+			p.b *= scale;
+			return p;
+		}
+
+		const size_t q = slice.strikes.size();
+		size_t lowest = 0;
+		vector<double> k(q), w(q);
+		for (size_t i = 0; i < q; i++)
+		{
+			k[i] = log(slice.strikes[i] / slice.forward);
+			w[i] = slice.vols[i] * slice.vols[i] * slice.maturity;
+			if (w[i] < w[lowest]) lowest = i;
+		}
+		const size_t left = min_element(k.begin(), k.end()) - k.begin(), right = max_element(k.begin(), k.end()) - k.begin();
+		SVIParameters p;
+		p.m = k[lowest];
+		const double sL = left != lowest ? (w[left] - w[lowest]) / (k[left] - p.m) : 0.0;
+		const double sR = right != lowest ? (w[right] - w[lowest]) / (k[right] - p.m) : 0.0;
+		p.b = max(1e-3, 0.5 * (sR - sL));
+		p.rho = min(0.9, max(-0.9, (sR + sL) / (sR - sL + 1e-12)));
+		p.a = max(0.0, w[lowest] - p.b * p.sigma * sqrt(1.0 - p.rho * p.rho));
+		return p;
+	}
+
+	// Fits one slice from guess, with the calendar penalty against previous when given
+	Fit FitSlice(SVISolver& solver, const SVISlice& slice, const SVIParameters& guess, const SVIParameters* previous, double penalty) const
+	{
+		const size_t q = slice.strikes.size();
+		const size_t grid = previous ? calendarGrid : 0;
+		vector<double> k(q), w(q), sw(q);
+		double kLow = 0.0, kHigh = 0.0;
+		for (size_t i = 0; i < q; i++)
+		{
+			k[i] = log(slice.strikes[i] / slice.forward);
+			w[i] = slice.vols[i] * slice.vols[i] * slice.maturity;
+			sw[i] = slice.weights.empty() ? 1.0 : sqrt(slice.weights[i]);
+			kLow = min(kLow, k[i]);
+			kHigh = max(kHigh, k[i]);
+		}
+
+		// residuals: weighted quote errors, the minimum variance floor, then the calendar penalties
+		auto residuals = [&](const double* x, double* f, double* J) {
+			const double a = x[0], b = x[1], rho = x[2], m = x[3], sigma = x[4];
+			auto row = [&](double kk, double scale, double* Ji) {
+				const double d = kk - m, r = sqrt(d * d + sigma * sigma);
+				Ji[0] = scale;
+				Ji[1] = scale * (rho * d + r);
+				Ji[2] = scale * b * d;
+				Ji[3] = -scale * b * (rho + d / r);
+				Ji[4] = scale * b * sigma / r;
+				return a + b * (rho * d + r);
+			};
+			for (size_t i = 0; i < q; i++)
+				f[i] = sw[i] * (row(k[i], sw[i], J + i * 5) - w[i]);
+
+			const double s = sqrt(1.0 - rho * rho), floor = a + b * sigma * s;
+			double* Jf = J + q * 5;
+			if (floor < 0.0)
+			{
+				f[q] = penalty * floor;
+				Jf[0] = penalty;
+				Jf[1] = penalty * sigma * s;
+				Jf[2] = -penalty * b * sigma * rho / s;
+				Jf[3] = 0.0;
+				Jf[4] = penalty * b * s;
+			}
+			else
+			{
+				f[q] = 0.0;
+				fill(Jf, Jf + 5, 0.0);
+			}
+
+			for (size_t j = 0; j < grid; j++)
+			{
+				const double kk = gridLow + (gridHigh - gridLow) * j / (grid - 1);
+				double* Jj = J + (q + 1 + j) * 5;
+				const double gap = row(kk, penalty, Jj) - previous->TotalVariance(kk);
+				if (gap < 0.0) f[q + 1 + j] = penalty * gap;
+				else
+				{
+					f[q + 1 + j] = 0.0;
+					fill(Jj, Jj + 5, 0.0);
+				}
+			}
+		};
+
+		// b >= 0, |rho| < 1, sigma > 0, m within reach of the quotes
+		solver.lower = { -numeric_limits<double>::infinity(), 0.0, -0.999, kLow - 1.0, 1e-4 };
+		solver.upper = { numeric_limits<double>::infinity(), numeric_limits<double>::infinity(), 0.999, kHigh + 1.0, 10.0 };
+		SVISolver::Parameters x = { guess.a, guess.b, guess.rho, guess.m, guess.sigma };
+		auto report = solver.Minimize(residuals, q + 1 + grid, x);
+
+		Fit fit;
+		fit.parameters.a = x[0];
+		fit.parameters.b = x[1];
+		fit.parameters.rho = x[2];
+		fit.parameters.m = x[3];
+		fit.parameters.sigma = x[4];
+		fit.iterations = report.iterations;
+		double sse = 0.0;
+		for (size_t i = 0; i < q; i++)
+		{
+			const double e = fit.parameters.TotalVariance(k[i]) - w[i];
+			sse += e * e;
+		}
+		fit.rmsError = sqrt(sse / q);
+		return fit;
+	}
+
+	double CalendarViolation(const SVIParameters& earlier, const SVIParameters& later) const
+	{
+		double worst = 0.0;
+		for (unsigned int j = 0; j < calendarGrid; j++)
+		{
+			const double kk = gridLow + (gridHigh - gridLow) * j / (calendarGrid - 1);
+			worst = max(worst, earlier.TotalVariance(kk) - later.TotalVariance(kk));
+		}
+		return worst;
+	}
+};
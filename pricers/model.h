@@ -1,11 +1,30 @@
+#pragma once
 #include <vector>
 using namespace std;
 typedef std::vector<double> SamplePath;
 
+// Source of the Gaussian draws in Monte Carlo
+// PseudoRandom: Philox substream per path, QuasiRandom: Sobol with Brownian bridge over the mesh
+enum randomGenerator {
+    PseudoRandom, QuasiRandom
+};
+
+// Variance reduction built into CalculateMC
+// Antithetic: paths 2j and 2j + 1 use the Gaussians of draw j and their opposites
+// MomentMatching: the Gaussians of each step are shifted and scaled to mean 0 and variance 1 across every chunk of paths
+enum varianceReduction {
+    NoVarianceReduction, Antithetic, MomentMatching
+};
+
 class Model {
 public:
     double drift, sigma;
     double PricingError, delta;
+    unsigned long long PathsUsed = 0;
+    double VarianceReductionFactor = 1.0; // plain MC variance over achieved variance, for the same number of paths
+    double vega, rho, theta; // filled by the AAD Monte Carlo, theta also by the PDE
+    double gamma = 0.0; // filled by the PDE
+    unsigned long long seed = 0; // seed of the MC random streams, see CalculateMC
     virtual void GenerateSamplePath(double T, int m, SamplePath& S) = 0;
 private:
     virtual void Update_Params() = 0;
@@ -1,19 +1,38 @@
 #include <cstdlib>
 #include <ctime>
 #include <cmath>
+#include <atomic>
 #include "model.h"
+#include "../math_library/philox.h"
+#include "../math_library/gaussians.h"
 
 #pragma once
 
 const double PI = atan(1) * 4;
 
-double Gauss()
+// Default stream for the free-standing Gauss()/Poisson():
+// one Philox substream per thread, no shared state and no libc lock
+inline Philox& defaultGenerator()
+{
+	static atomic<unsigned long long> nextStream{ 0 };
+	thread_local Philox gen(0, nextStream++);
+	return gen;
+}
+
+// Box-Muller draw on an explicit 64-bit engine (Philox, std::mt19937_64, ...)
+template <class RNG>
+double Gauss(RNG& gen)
 {
-	double U1 = (rand() + 1.0) / (RAND_MAX + 1.0);
-	double U2 = (rand() + 1.0) / (RAND_MAX + 1.0);
+	double U1 = ((gen() >> 11) + 1.0) / 9007199254740992.0;
+	double U2 = ((gen() >> 11) + 1.0) / 9007199254740992.0;
 	return sqrt(-2.0 * log(U1)) * cos(2.0 * PI * U2);
 }
 
+double Gauss()
+{
+	return Gauss(defaultGenerator());
+}
+
 /*
 algorithm Poisson generator based upon the inversion by sequential search:
     init:
@@ -25,8 +44,9 @@ algorithm Poisson generator based upon the inversion by sequential search:
         s ← s + p.
     return x.
 */
-double Poisson(double lambda){
-    double u = (rand() + 1.0) / (RAND_MAX + 1.0);
+template <class RNG>
+double Poisson(double lambda, RNG& gen){
+    double u = ((gen() >> 11) + 1.0) / 9007199254740992.0;
     double x = 0;
     double p = exp(-lambda);
     double s = p;
@@ -38,16 +58,12 @@ double Poisson(double lambda){
     return x;
 }
 
+double Poisson(double lambda){
+    return Poisson(lambda, defaultGenerator());
+}
+
+// Standard normal CDF, same function as normalCdf
 double N(double x)
 {
-    double gamma = 0.2316419; double a1 = 0.319381530;
-    double a2 = -0.356563782; double a3 = 1.781477937;
-    double a4 = -1.821255978; double a5 = 1.330274429;
-    //double pi = 4.0 * atan(1.0);
-    double k = 1.0 / (1.0 + gamma * x);
-    if (x >= 0.0)
-    {
-        return 1.0 - ((((a5 * k + a4) * k + a3) * k + a2) * k + a1) * k * exp(-x * x / 2.0) / sqrt(2.0 * PI);
-    }
-    else return 1.0 - N(-x);
+    return normalCdf(x);
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include"derivatives.hpp"
+#include"PathBlock.h"
 #include"../math_library/Solver/NewtonSolver.hpp"
+#include<stdexcept>
 /*
 # The philosophy to this code base is as follows: we treat models as wrappers on top of contracts to reduce the load information storage
 # Each derivatives contract is designed to have flexible contract details acts as a wrapper on top of some underlying asset(s)
@@ -31,6 +33,7 @@ namespace Derivatives {
             underlyers = b.underlyers;
             strike = b.strike;
             maturity = b.maturity;
+            tenor = b.tenor;
             r = b.r;
             _implied_vol = b._implied_vol;
             style = b.style;
@@ -41,9 +44,25 @@ namespace Derivatives {
         double tenor;
         double r;
         bool isCall;
-        bool use_MC = true; // flag for calulcating premium using Monte Carlo ELSE PDEd
+        bool use_MC = true; // flag for calulcating premium using Monte Carlo ELSE PDE, see BSModel::Calculate
         virtual double Payoff(SamplePath& S) = 0;// { return max(0.0, (isCall ? 1 : -1) * (S.back() - strike)); };
 
+        // Same payoff on a path recorded on the AAD tape, required by BSModel::CalculateMCGreeks
+        virtual Number Payoff(vector<Number>&) {
+            throw runtime_error("Option: no AAD payoff for this contract");
+        }
+
+        // Payoffs of all paths of a block into out[0..block.paths()-1], temporaries in the caller's scratch
+        // Generic version copies each path out, vanilla payoffs override it with a kernel across paths
+        virtual void PayoffBlock(const PathBlock& block, double* out, PayoffScratch& scratch) {
+            SamplePath& S = scratch.path;
+            S.resize(block.steps());
+            for (size_t p = 0; p < block.paths(); ++p) {
+                for (size_t k = 0; k < block.steps(); ++k) S[k] = block(k, p);
+                out[p] = Payoff(S);
+            }
+        }
+
         // this function loads premium -- to be overloaded if PDE solution is present
         double getPremium() {
             return this->Price();
@@ -53,6 +72,11 @@ namespace Derivatives {
             return style;
         }
 
+        // American and Bermudan exercise are priced by LSMCEngine
+        void setStyle(optionStyle _style) {
+            style = _style;
+        }
+
         void setPremium(double premium){
             this->updatePx(premium);
         }
@@ -120,12 +144,23 @@ namespace Derivatives {
     };
 
     
-    class EurOption : public Option {
+    // Options whose payoff is known at compile time
+    // Derived implements template <class T> T PayoffT(const vector<T>& S), for double and Number paths,
+    // and gets the virtual Payoff overloads from it; BSModel::CalculateMCInline<Derived> calls PayoffT directly
+    template <class Derived>
+    class StaticPayoffOption : public Option {
+    public:
+        using Option::Option;
+        double Payoff(SamplePath& S) { return static_cast<Derived*>(this)->PayoffT(S); }
+        Number Payoff(vector<Number>& S) { return static_cast<Derived*>(this)->PayoffT(S); }
+    };
+
+    class EurOption : public StaticPayoffOption<EurOption> {
     public:
         explicit EurOption(vector<Asset> underlyer, bool _isCall = true, double _k = 0, double _t = 0, double _m = 0, double _r = 0,
             double _iv = 0, double _premium = 0) :
-            Option(underlyer, European, isCall, _k, _t, _m, _r, _iv, _premium) {};
-        EurOption() :Option() {};
+            StaticPayoffOption(underlyer, European, _isCall, _k, _t, _m, _r, _iv, _premium) {};
+        EurOption() :StaticPayoffOption() {};
 
         double d_plus(double S0, double sigma, double r);
         double d_minus(double S0, double sigma, double r);
@@ -133,8 +168,17 @@ namespace Derivatives {
         double VegaByBSFormula(double S0, double sigma, double r);
         double DeltaByBSFormula(double S0, double sigma, double r);
 
+        template <class T>
+        T PayoffT(const vector<T>& S) const { return max(0.0, (isCall ? 1.0 : -1.0) * (S.back() - strike)); }
+
     private:
-        double Payoff(SamplePath& S) { return max(0.0, (isCall ? 1 : -1) * (S.back() - strike)); };
+        void PayoffBlock(const PathBlock& block, double* out, PayoffScratch&) {
+            using namespace Simd;
+            const double* ST = block.row(block.steps() - 1);
+            const vdouble K = set1(strike), sign = set1(isCall ? 1.0 : -1.0), zero = set1(0.0);
+            for (size_t p = 0; p < block.paths(); p += width)
+                storeu(out + p, max(zero, sign * (load(ST + p) - K)));
+        }
     };
     
     double EurOption::d_plus(double S0, double sigma, double r)
@@ -179,5 +223,40 @@ namespace Derivatives {
         {
             return Ptr1->Payoff(S) - Ptr2->Payoff(S);
         }
+        Number Payoff(vector<Number>& S)
+        {
+            return Ptr1->Payoff(S) - Ptr2->Payoff(S);
+        }
+        // The second leg goes to the scratch buffer of this nesting level, nested differences use the levels below
+        // Only the buffer's data is kept: growing the list of levels moves the vectors but not their data
+        void PayoffBlock(const PathBlock& block, double* out, PayoffScratch& scratch)
+        {
+            Ptr1->PayoffBlock(block, out, scratch);
+            const size_t level = scratch.depth;
+            if (scratch.legs.size() <= level) scratch.legs.resize(level + 1);
+            scratch.legs[level].resize(block.paths());
+            double* const second = scratch.legs[level].data();
+            scratch.depth = level + 1;
+            Ptr2->PayoffBlock(block, second, scratch);
+            scratch.depth = level;
+            for (size_t p = 0; p < block.paths(); ++p) out[p] -= second[p];
+        }
+    };
+
+    // DifferenceOfOptions of two option types known at compile time, usable with BSModel::CalculateMCInline
+    template <class Option1, class Option2>
+    class StaticDifferenceOfOptions : public StaticPayoffOption<StaticDifferenceOfOptions<Option1, Option2>>
+    {
+    public:
+        Option1* Ptr1;
+        Option2* Ptr2;
+        StaticDifferenceOfOptions(double T_, double m_, Option1* Ptr1_, Option2* Ptr2_) : Ptr1(Ptr1_), Ptr2(Ptr2_)
+        {
+            this->tenor = T_; this->maturity = m_; this->r = Ptr1->r;
+            for (auto& i : Ptr1->underlyers) this->underlyers.push_back(i);
+            for (auto& j : Ptr2->underlyers) this->underlyers.push_back(j);
+        }
+        template <class T>
+        T PayoffT(const vector<T>& S) const { return Ptr1->PayoffT(S) - Ptr2->PayoffT(S); }
     };
 }
\ No newline at end of file
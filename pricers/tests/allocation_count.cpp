@@ -0,0 +1,31 @@
+#include <cstdlib>
+#include <new>
+#include "allocation_count.h"
+
+// Replacements of the global operator new/delete, kept out of test.cpp so that
+// the inlined new/delete pairs of the tests do not trip -Wmismatched-new-delete
+std::atomic<size_t> allocationCount{ 0 };
+
+void* operator new(size_t n) {
+	++allocationCount;
+	if (void* p = std::malloc(n ? n : 1)) return p;
+	throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+#ifdef _WIN32
+static void* alignedMalloc(size_t n, size_t a) { return _aligned_malloc(n, a); }
+static void alignedFree(void* p) { _aligned_free(p); }
+#else
+static void* alignedMalloc(size_t n, size_t a) { return std::aligned_alloc(a, (n + a - 1) / a * a); }
+static void alignedFree(void* p) { std::free(p); }
+#endif
+
+void* operator new(size_t n, std::align_val_t al) {
+	++allocationCount;
+	if (void* p = alignedMalloc(n ? n : 1, size_t(al))) return p;
+	throw std::bad_alloc();
+}
+void operator delete(void* p, std::align_val_t) noexcept { alignedFree(p); }
+void operator delete(void* p, size_t, std::align_val_t) noexcept { alignedFree(p); }
@@ -0,0 +1,6 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+
+// Counts every heap allocation of the test binary, see allocation_count.cpp
+extern std::atomic<size_t> allocationCount;
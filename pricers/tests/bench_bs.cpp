@@ -0,0 +1,83 @@
+#include <chrono>
+#include <iostream>
+#include "../BSModel.h"
+#include "../BachelierBatch.h"
+
+// Closed-form chain pricing throughput: EurOption::PriceByBSFormula, DeltaByBSFormula and VegaByBSFormula
+// one option at a time against the SIMD batch kernel (price and five Greeks), then the batch implied vol solver
+// repricing the chain, and the same for the Bachelier kernels (vols read as normal vols of 100x the BS ones)
+// Build with the target SIMD flags, e.g. bazel run -c opt --copt=-mavx2 --copt=-mfma //pricers/tests:bench_bs
+int main()
+{
+	const size_t n = 50000, repeats = 20;
+	Asset underlyer;
+	underlyer.updatePx(100.0);
+	vector<EurOption> options;
+	OptionChain chain;
+	for (size_t i = 0; i < n; i++)
+	{
+		const double K = 50.0 + 100.0 * i / n, T = 0.1 + (i % 20) * 0.1, sigma = 0.1 + (i % 7) * 0.05;
+		const bool call = i % 2 == 0;
+		options.emplace_back(vector<Asset>{ underlyer }, call, K, T, T, 0.03, sigma);
+		chain.push_back(100.0, K, T, 0.03, sigma, call);
+	}
+
+	double check = 0.0;
+	auto start = chrono::steady_clock::now();
+	for (size_t k = 0; k < repeats; k++)
+	{
+		for (auto& o : options)
+		{
+			const double sigma = o.impliedVol();
+			check += o.PriceByBSFormula(100.0, sigma, o.r) + o.DeltaByBSFormula(100.0, sigma, o.r) + o.VegaByBSFormula(100.0, sigma, o.r);
+		}
+	}
+	double scalar = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	ChainGreeks greeks;
+	start = chrono::steady_clock::now();
+	for (size_t k = 0; k < repeats; k++)
+	{
+		PriceByBSFormula(chain, greeks);
+		check += greeks.price[k] + greeks.delta[k] + greeks.vega[k];
+	}
+	double simd = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	vector<double> prices(greeks.price.begin(), greeks.price.begin() + n);
+	vector<impliedVolStatus> status;
+	start = chrono::steady_clock::now();
+	for (size_t k = 0; k < repeats; k++)
+	{
+		ImpliedVolByBSFormula(chain, prices.data(), status);
+		check += chain.vol[k];
+	}
+	double iv = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	for (size_t i = 0; i < n; i++) chain.vol[i] *= 100.0;
+	start = chrono::steady_clock::now();
+	for (size_t k = 0; k < repeats; k++)
+	{
+		PriceByBachelierFormula(chain, greeks);
+		check += greeks.price[k] + greeks.delta[k] + greeks.vega[k];
+	}
+	double normal = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	prices.assign(greeks.price.begin(), greeks.price.begin() + n);
+	start = chrono::steady_clock::now();
+	for (size_t k = 0; k < repeats; k++)
+	{
+		ImpliedNormalVolByBachelierFormula(chain, prices.data(), status);
+		check += chain.vol[k];
+	}
+	double normalIV = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	double priced = double(n) * repeats;
+	cout << "SIMD width " << Simd::width << endl;
+	cout << "scalar price, delta, vega: " << scalar / priced * 1e9 << " ns/option" << endl;
+	cout << "batch price and Greeks:    " << simd / priced * 1e9 << " ns/option" << endl;
+	cout << "batch implied vol:         " << iv / priced * 1e9 << " ns/option" << endl;
+	cout << "batch Bachelier, Greeks:   " << normal / priced * 1e9 << " ns/option" << endl;
+	cout << "batch normal implied vol:  " << normalIV / priced * 1e9 << " ns/option" << endl;
+	cout << "speedup " << scalar / simd << "x (checksum " << check << ")" << endl;
+	return 0;
+}
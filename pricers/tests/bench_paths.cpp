@@ -0,0 +1,122 @@
+#include <chrono>
+#include <iostream>
+#include "../BSModel.h"
+#include "../PayoffScript.h"
+#include "../Lattice.h"
+
+// GBM path generation throughput: scalar GenerateSamplePath against GeneratePathBlock,
+// then CalculateMC with the virtual payoff against CalculateMCInline,
+// and hand-written PayoffBlock kernels against the same payoffs compiled from PayoffScript,
+// then CalculatePDE (European call and American put, default grid) against the CalculateMC run,
+// and LatticeEngine on the American put (CRR, 500 steps), one strike at a time against CalculateStrikes on a strip
+// Build with the target SIMD flags, e.g. bazel run -c opt --copt=-mavx2 --copt=-mfma //pricers/tests:bench_paths
+int main()
+{
+	const unsigned int paths = 1 << 16, mesh = 256;
+	Asset underlyer;
+	underlyer.updatePx(100.0);
+	EurOption call({ underlyer }, true, 100.0, 1.0, 1.0, 0.05, 0.2);
+	BSModel model(&call);
+
+	double check = 0.0;
+	auto start = chrono::steady_clock::now();
+	SamplePath path;
+	for (unsigned int i = 0; i < paths; i++)
+	{
+		model.GenerateSamplePath(1.0, mesh, path);
+		check += path.back();
+	}
+	double scalar = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	start = chrono::steady_clock::now();
+	PathBlock block(mesh, BSModel::pathBlockSize);
+	for (unsigned int first = 0; first < paths; first += BSModel::pathBlockSize)
+	{
+		model.GeneratePathBlock(1.0, mesh, first, block);
+		check += block(mesh - 1, 0);
+	}
+	double simd = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	const unsigned int mcPaths = 1 << 18, mcMesh = 16;
+	start = chrono::steady_clock::now();
+	model.CalculateMC(mcPaths, mcMesh);
+	double virtualMC = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	check += call.getPremium();
+	start = chrono::steady_clock::now();
+	model.CalculateMCInline<EurOption>(mcPaths, mcMesh);
+	double inlineMC = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	check += call.getPremium();
+
+	// payoff kernels alone, over one block of generated paths
+	EurOption upper({ underlyer }, true, 110.0, 1.0, 1.0, 0.05, 0.2);
+	DifferenceOfOptions spread(1.0, 1.0, &call, &upper);
+	ScriptedOption scriptedCall({ underlyer }, "max(S - K, 0)", { { "K", 100.0 } });
+	ScriptedOption scriptedSpread({ underlyer }, "max(S - K, 0) - max(S - K2, 0)", { { "K", 100.0 }, { "K2", 110.0 } });
+	model.GeneratePathBlock(1.0, mcMesh, 0, block);
+	vector<double> out(block.paths());
+	PayoffScratch scratch;
+	auto timeKernel = [&](Option& option) {
+		const unsigned int repeats = 1 << 14;
+		auto t0 = chrono::steady_clock::now();
+		for (unsigned int i = 0; i < repeats; i++)
+		{
+			option.PayoffBlock(block, out.data(), scratch);
+			check += out[i % out.size()];
+		}
+		return chrono::duration<double>(chrono::steady_clock::now() - t0).count() / (double(repeats) * block.paths()) * 1e9;
+	};
+	const double callKernel = timeKernel(call), scriptedCallKernel = timeKernel(scriptedCall);
+	const double spreadKernel = timeKernel(spread), scriptedSpreadKernel = timeKernel(scriptedSpread);
+
+	const unsigned int pdeRepeats = 200;
+	start = chrono::steady_clock::now();
+	for (unsigned int i = 0; i < pdeRepeats; i++)
+	{
+		model.CalculatePDE();
+		check += call.getPremium();
+	}
+	double pde = chrono::duration<double>(chrono::steady_clock::now() - start).count() / pdeRepeats;
+	EurOption put({ underlyer }, false, 100.0, 1.0, 1.0, 0.05, 0.2);
+	put.setStyle(American);
+	BSModel putModel(&put);
+	start = chrono::steady_clock::now();
+	for (unsigned int i = 0; i < pdeRepeats; i++)
+	{
+		putModel.CalculatePDE();
+		check += put.getPremium();
+	}
+	double americanPDE = chrono::duration<double>(chrono::steady_clock::now() - start).count() / pdeRepeats;
+
+	LatticeEngine lattice(putModel);
+	start = chrono::steady_clock::now();
+	for (unsigned int i = 0; i < pdeRepeats; i++)
+	{
+		lattice.Calculate();
+		check += put.getPremium();
+	}
+	double americanLattice = chrono::duration<double>(chrono::steady_clock::now() - start).count() / pdeRepeats;
+	vector<double> strikes(64), prices;
+	for (size_t k = 0; k < strikes.size(); k++) strikes[k] = 70.0 + k;
+	start = chrono::steady_clock::now();
+	for (unsigned int i = 0; i < pdeRepeats; i++)
+	{
+		lattice.CalculateStrikes(strikes, prices);
+		check += prices[i % prices.size()];
+	}
+	double stripLattice = chrono::duration<double>(chrono::steady_clock::now() - start).count() / (double(pdeRepeats) * strikes.size());
+
+	double steps = double(paths) * mesh;
+	cout << "SIMD width " << Simd::width << endl;
+	cout << "GenerateSamplePath: " << steps / scalar / 1e6 << " M steps/s" << endl;
+	cout << "GeneratePathBlock:  " << steps / simd / 1e6 << " M steps/s" << endl;
+	cout << "speedup " << scalar / simd << "x" << endl;
+	cout << "CalculateMC:        " << virtualMC / mcPaths * 1e9 << " ns/path" << endl;
+	cout << "CalculateMCInline:  " << inlineMC / mcPaths * 1e9 << " ns/path (checksum " << check << ")" << endl;
+	cout << "CalculatePDE:       " << pde * 1e6 << " us European, " << americanPDE * 1e6 << " us American ("
+		<< virtualMC / pde << "x faster than CalculateMC above)" << endl;
+	cout << "LatticeEngine:      " << americanLattice * 1e6 << " us American put, " << stripLattice * 1e6
+		<< " us per strike on a strip of " << strikes.size() << endl;
+	cout << "PayoffBlock call:   " << callKernel << " ns/path, scripted " << scriptedCallKernel << " ns/path" << endl;
+	cout << "PayoffBlock spread: " << spreadKernel << " ns/path, scripted " << scriptedSpreadKernel << " ns/path (checksum " << check << ")" << endl;
+	return 0;
+}
@@ -2,7 +2,16 @@
 #include <numeric>
 #include <gtest/gtest.h>
 #include "../BSModel.h"
+#include "../PortfolioMC.h"
+#include "../BSBatch.h"
+#include "../SVISurface.h"
+#include "../Bachelier.h"
+#include "../BachelierBatch.h"
+#include "../PayoffScript.h"
+#include "../LSMC.h"
+#include "../Lattice.h"
 #include "test.h"
+#include "allocation_count.h"
 
 TEST(PricerTests, GaussDistributionLooksNormal) {
 	const size_t number_of_samples = 1000;
@@ -27,4 +36,779 @@ TEST(PricerTests, GaussDistributionLooksNormal) {
 	double variance = second_moment - average * average;
 	EXPECT_LE(variance, 1.1);
 	EXPECT_GE(variance, 0.9);
-}
\ No newline at end of file
+}
+static EurOption MakeCall(double spot = 100.0, double strike = 100.0, double T = 1.0, double r = 0.05, double vol = 0.2) {
+	Asset underlyer;
+	underlyer.updatePx(spot);
+	return EurOption({ underlyer }, true, strike, T, T, r, vol);
+}
+
+TEST(PricerTests, ParallelMCMatchesSerial) {
+	EurOption serialCall = MakeCall(), parallelCall = MakeCall();
+	BSModel serial(&serialCall), parallel(&parallelCall);
+	serial.seed = parallel.seed = 42;
+	serial.CalculateMC(20000, 4);
+	parallel.CalculateMC(20000, 4, 0.0001, false, 4);
+
+	EXPECT_EQ(serialCall.getPremium(), parallelCall.getPremium());
+	EXPECT_EQ(serial.PricingError, parallel.PricingError);
+	EXPECT_EQ(serial.delta, parallel.delta);
+	EXPECT_NEAR(serialCall.getPremium(), serialCall.PriceByBSFormula(100.0, 0.2, 0.05), 4 * serial.PricingError);
+
+	// a copy keeps the seed and draws the same paths
+	const double premium = serialCall.getPremium();
+	BSModel copy(serial);
+	EXPECT_EQ(copy.seed, 42u);
+	copy.CalculateMC(20000, 4);
+	EXPECT_EQ(serialCall.getPremium(), premium);
+}
+
+TEST(PricerTests, SobolBridgeBeatsPseudoRandom) {
+	EurOption call = MakeCall();
+	const double exact = call.PriceByBSFormula(100.0, 0.2, 0.05);
+	BSModel model(&call);
+	model.seed = 7;
+	model.CalculateMC(4096, 16, 0.0001, false, 1, QuasiRandom);
+	const double qmcError = std::abs(call.getPremium() - exact);
+	model.CalculateMC(4096, 16);
+	EXPECT_LT(qmcError, 0.25 * model.PricingError);
+}
+
+TEST(PricerTests, BlockMCMatchesBSAndThreads) {
+	EurOption call = MakeCall();
+	BSModel serial(&call), parallel(&call);
+	serial.seed = parallel.seed = 11;
+	serial.CalculateMCBlock(50000, 8);
+	const double price = call.getPremium();
+	parallel.CalculateMCBlock(50000, 8, 0.0001, 3);
+
+	EXPECT_EQ(price, call.getPremium());
+	EXPECT_EQ(serial.delta, parallel.delta);
+	EXPECT_EQ(parallel.PathsUsed, 50000u);
+	EXPECT_NEAR(price, call.PriceByBSFormula(100.0, 0.2, 0.05), 4 * serial.PricingError);
+	EXPECT_NEAR(serial.delta, call.DeltaByBSFormula(100.0, 0.2, 0.05), 0.02);
+}
+
+TEST(PricerTests, MCLoopDoesNotAllocate) {
+	EurOption call = MakeCall();
+	BSModel model(&call);
+	auto allocations = [&](unsigned int iteration, randomGenerator generator) {
+		size_t before = allocationCount;
+		model.CalculateMC(iteration, 64, 0.0001, false, 1, generator);
+		return allocationCount - before;
+	};
+	// the first run sizes the workspace, after that the count must not depend on the number of paths
+	allocations(1024, PseudoRandom);
+	size_t few = allocations(1024, PseudoRandom), many = allocations(65536, PseudoRandom);
+	EXPECT_EQ(few, many);
+
+	allocations(1024, QuasiRandom);
+	few = allocations(1024, QuasiRandom);
+	many = allocations(65536, QuasiRandom);
+	EXPECT_EQ(few, many);
+
+	model.CalculateMCBlock(1024, 64);
+	size_t before = allocationCount;
+	model.CalculateMCBlock(1024, 64);
+	size_t blockFew = allocationCount - before;
+	before = allocationCount;
+	model.CalculateMCBlock(65536, 64);
+	EXPECT_EQ(blockFew, allocationCount - before);
+
+	// payoffs combined at run time take their temporaries from the workspace too
+	EurOption upper = MakeCall(100.0, 110.0);
+	DifferenceOfOptions spread(1.0, 1.0, &call, &upper);
+	spread.r = 0.05;
+	BSModel spreadModel(&spread);
+	spreadModel.CalculateMCBlock(1024, 64);
+	before = allocationCount;
+	spreadModel.CalculateMCBlock(1024, 64);
+	blockFew = allocationCount - before;
+	before = allocationCount;
+	spreadModel.CalculateMCBlock(65536, 64);
+	EXPECT_EQ(blockFew, allocationCount - before);
+
+	// a difference nested in the second leg takes the next level of scratch
+	DifferenceOfOptions nested(1.0, 1.0, &upper, &spread);
+	PathBlock block(4, BSModel::pathBlockSize);
+	model.GeneratePathBlock(1.0, 4, 0, block);
+	std::vector<double> out(block.paths());
+	PayoffScratch scratch;
+	nested.PayoffBlock(block, out.data(), scratch);
+	SamplePath path(4);
+	for (size_t p = 0; p < block.paths(); p++) {
+		for (size_t k = 0; k < 4; k++) path[k] = block(k, p);
+		EXPECT_EQ(out[p], nested.Payoff(path));
+	}
+}
+
+TEST(PricerTests, StoredSamplesFollowPathOrder) {
+	EurOption call = MakeCall();
+	BSModel serial(&call), parallel(&call);
+	serial.CalculateMC(3000, 5, 0.0001, true);
+	parallel.CalculateMC(3000, 5, 0.0001, true, 3);
+	ASSERT_EQ(serial.Samples().Paths(), 3000u);
+	ASSERT_EQ(parallel.Samples().Paths(), 3000u);
+	std::vector<double> a(3000 * 5), b(3000 * 5);
+	serial.Samples().Read(0, 3000, a.data());
+	parallel.Samples().Read(0, 3000, b.data());
+	EXPECT_EQ(a, b);
+}
+
+TEST(PricerTests, MappedPathStoreRoundTrip) {
+	EurOption call = MakeCall();
+	BSModel memory(&call), mapped(&call);
+	const std::string file = ::testing::TempDir() + "paths.bin";
+	const std::string file32 = ::testing::TempDir() + "paths32.bin";
+	const std::string fileMesh = ::testing::TempDir() + "paths_mesh.bin";
+	memory.CalculateMC(3000, 7, 0.0001, true);
+	const double premium = call.getPremium();
+	mapped.SetPathStore(std::make_shared<MappedPathStore>(file, false, 500));
+	mapped.CalculateMC(3000, 7, 0.0001, true, 2);
+	EXPECT_EQ(premium, call.getPremium());
+
+	// reopened file, read back by index range
+	auto store = MappedPathStore::Open(file);
+	ASSERT_EQ(store->Paths(), 3000u);
+	ASSERT_EQ(store->Mesh(), 7u);
+	EXPECT_EQ(store->Info().seed, mapped.seed);
+	EXPECT_EQ(store->Info().spot, 100.0);
+	std::vector<double> a(1200 * 7), b(1200 * 7);
+	memory.Samples().Read(1300, 1200, a.data());
+	store->Read(1300, 1200, b.data());
+	EXPECT_EQ(a, b);
+	EXPECT_THROW(store->Read(2500, 501, b.data()), std::out_of_range);
+	EXPECT_THROW(memory.Samples().Read(3001, 0, a.data()), std::out_of_range);
+	EXPECT_NO_THROW(store->Read(3000, 0, b.data()));
+
+	mapped.SetPathStore(std::make_shared<MappedPathStore>(file32, true));
+	mapped.CalculateMC(3000, 7, 0.0001, true);
+	auto store32 = MappedPathStore::Open(file32);
+	ASSERT_TRUE(store32->IsFloat32());
+	store32->Read(1300, 1200, b.data());
+	for (size_t i = 0; i < a.size(); i++) EXPECT_NEAR(a[i], b[i], 1e-6 * a[i]);
+
+	// a new mesh drops the paths, chunks start over: the last one was left part written
+	auto resized = std::make_shared<MappedPathStore>(fileMesh, false, 1024);
+	mapped.SetPathStore(resized);
+	mapped.CalculateMC(3000, 7, 0.0001, true, 2);
+	memory.CalculateMC(3000, 5, 0.0001, true);
+	mapped.CalculateMC(3000, 5, 0.0001, true, 2);
+	ASSERT_EQ(resized->Paths(), 3000u);
+	std::vector<double> c(3000 * 5), d(3000 * 5);
+	memory.Samples().Read(0, 3000, c.data());
+	resized->Read(0, 3000, d.data());
+	EXPECT_EQ(c, d);
+	std::remove(file.c_str());
+	std::remove(file32.c_str());
+	std::remove(fileMesh.c_str());
+}
+
+TEST(PricerTests, AADGreeksMatchBS) {
+	EurOption call = MakeCall();
+	BSModel model(&call);
+	model.CalculateMC(100000, 1);
+	const double premium = call.getPremium();
+	model.CalculateMCGreeks(100000, 1);
+	EXPECT_NEAR(call.getPremium(), premium, 1e-10);
+
+	const double S0 = 100.0, K = 100.0, T = 1.0, r = 0.05, vol = 0.2;
+	const double d1 = call.d_plus(S0, vol, r), d2 = call.d_minus(S0, vol, r);
+	const double rhoBS = K * T * exp(-r * T) * N(d2);
+	const double thetaBS = -S0 * normalDens(d1) * vol / (2.0 * sqrt(T)) - r * K * exp(-r * T) * N(d2);
+	EXPECT_NEAR(model.delta, call.DeltaByBSFormula(S0, vol, r), 0.005);
+	EXPECT_NEAR(model.vega, call.VegaByBSFormula(S0, vol, r), 0.5);
+	EXPECT_NEAR(model.rho, rhoBS, 0.5);
+	EXPECT_NEAR(model.theta, thetaBS, 0.1);
+
+	// stepping the path does not change the Greeks of a GBM European
+	model.CalculateMCGreeks(20000, 12);
+	EXPECT_EQ(model.PathsUsed, 20000u);
+	EXPECT_NEAR(model.delta, call.DeltaByBSFormula(S0, vol, r), 0.01);
+	EXPECT_NEAR(model.vega, call.VegaByBSFormula(S0, vol, r), 1.0);
+
+	// workers record on tapes of their own and leave the calling thread's tape alone,
+	// chunk sums are reduced in order so the Greeks do not depend on the thread count
+	Tape* const callerTape = Number::tape;
+	const double premium12 = call.getPremium(), delta = model.delta, vega = model.vega, rho = model.rho, theta = model.theta;
+	model.CalculateMCGreeks(20000, 12, PseudoRandom, 4);
+	EXPECT_EQ(Number::tape, callerTape);
+	EXPECT_EQ(call.getPremium(), premium12);
+	EXPECT_EQ(model.delta, delta);
+	EXPECT_EQ(model.vega, vega);
+	EXPECT_EQ(model.rho, rho);
+	EXPECT_EQ(model.theta, theta);
+}
+
+TEST(PricerTests, WorkerExceptionsReachTheCaller) {
+	// no AAD payoff for a scripted contract: every worker throws, the call does too
+	Asset underlyer;
+	underlyer.updatePx(100.0);
+	ScriptedOption scripted({ underlyer }, "max(S - K, 0)", { { "K", 100.0 } }, 1.0, 1.0, 0.05, 0.2);
+	BSModel model(&scripted);
+	EXPECT_THROW(model.CalculateMCGreeks(4096, 4, PseudoRandom, 2), std::runtime_error);
+	EXPECT_THROW(model.CalculateMCGreeks(4096, 4, PseudoRandom, 1), std::runtime_error);
+	// and the model still prices afterwards
+	EXPECT_NO_THROW(model.CalculateMC(4096, 4, 0.0001, false, 2));
+}
+
+TEST(PricerTests, VarianceReductionModes) {
+	EurOption call = MakeCall();
+	BSModel model(&call);
+	const double bs = call.PriceByBSFormula(100.0, 0.2, 0.05);
+	model.CalculateMC(50000, 1);
+	EXPECT_EQ(model.VarianceReductionFactor, 1.0);
+	const double plainError = model.PricingError;
+
+	model.CalculateMC(50000, 1, 0.0001, false, 1, PseudoRandom, Antithetic);
+	EXPECT_NEAR(call.getPremium(), bs, 3 * model.PricingError);
+	EXPECT_GT(model.VarianceReductionFactor, 1.5);
+	EXPECT_LT(model.PricingError, plainError);
+
+	// antithetic pairs stay together whatever the thread count
+	const double premium = call.getPremium();
+	model.CalculateMC(50000, 1, 0.0001, false, 3, PseudoRandom, Antithetic);
+	EXPECT_EQ(call.getPremium(), premium);
+
+	model.CalculateMC(50000, 4, 0.0001, false, 1, PseudoRandom, MomentMatching);
+	EXPECT_NEAR(call.getPremium(), bs, 4 * model.PricingError);
+	EXPECT_GT(model.VarianceReductionFactor, 1.0);
+}
+
+TEST(PricerTests, AdaptiveMCStopsAtTarget) {
+	EurOption call = MakeCall();
+	BSModel model(&call);
+	model.CalculateMCAdaptive(0.05, 1000000, 1);
+	EXPECT_LE(model.PricingError, 0.05);
+	EXPECT_LT(model.PathsUsed, 1000000u);
+	EXPECT_EQ(model.PathsUsed % (8 * BSModel::mcChunkSize), 0u);
+	const double premium = call.getPremium(), error = model.PricingError;
+	const unsigned long long paths = model.PathsUsed;
+
+	// same paths as the fixed-size engine, whatever the thread count
+	model.CalculateMCAdaptive(0.05, 1000000, 1, 0.0001, 3);
+	EXPECT_EQ(model.PathsUsed, paths);
+	EXPECT_EQ(call.getPremium(), premium);
+	model.CalculateMC(unsigned(paths), 1);
+	EXPECT_EQ(call.getPremium(), premium);
+	EXPECT_EQ(model.PricingError, error);
+
+	// smaller batches stop on the first chunk past the target, no later than the default ones
+	model.CalculateMCAdaptive(0.05, 1000000, 1, 0.0001, 1, PseudoRandom, NoVarianceReduction, 0.0, 1);
+	EXPECT_LE(model.PricingError, 0.05);
+	EXPECT_LE(model.PathsUsed, paths);
+	EXPECT_GT(model.PathsUsed, paths - 8 * BSModel::mcChunkSize);
+
+	// 1bp of a 100 notional is 0.01, out of reach within the budget
+	model.CalculateMCAdaptive(1.0, 20000, 1, 0.0001, 1, PseudoRandom, NoVarianceReduction, 100.0);
+	EXPECT_EQ(model.PathsUsed, 20000u);
+	EXPECT_GT(model.PricingError, 0.01);
+}
+
+TEST(PricerTests, PortfolioSharesPathsAcrossTrades) {
+	auto trade = [](size_t k) { return k < 40 ? MakeCall(100.0, 80.0 + k) : MakeCall(100.0, 100.0, 1.0, 0.05, 0.3); };
+	std::vector<EurOption> chain;
+	for (size_t k = 0; k <= 40; k++) chain.push_back(trade(k));
+	PortfolioMC book;
+	book.seed = 7;
+	for (auto& o : chain) book.Add(&o);
+	EXPECT_EQ(book.Groups(), 2u);
+	book.CalculateMC(5000, 4, 0.0001, 2);
+
+	for (size_t k : { size_t(0), size_t(17), size_t(40) }) {
+		EurOption single = trade(k);
+		BSModel model(&single);
+		model.seed = 7;
+		model.CalculateMCBlock(5000, 4);
+		EXPECT_EQ(book.Results()[k].premium, single.getPremium());
+		EXPECT_EQ(book.Results()[k].PricingError, model.PricingError);
+		EXPECT_EQ(book.Results()[k].delta, model.delta);
+		EXPECT_EQ(chain[k].getPremium(), single.getPremium());
+	}
+}
+
+TEST(PricerTests, BatchBSMatchesScalarFormula) {
+	OptionChain chain;
+	std::vector<EurOption> options;
+	for (int i = 0; i < 37; i++) {
+		const double K = 60.0 + 2.0 * i, T = 0.25 + 0.1 * i, r = 0.01 * (i % 5), sigma = 0.1 + 0.02 * (i % 9);
+		Asset underlyer;
+		underlyer.updatePx(100.0);
+		options.push_back(EurOption({ underlyer }, i % 3 != 0, K, T, T, r, sigma));
+		chain.push_back(100.0, K, T, r, sigma, i % 3 != 0);
+	}
+	ChainGreeks out;
+	PriceByBSFormula(chain, out);
+	for (size_t i = 0; i < options.size(); i++) {
+		EurOption& o = options[i];
+		const double sigma = o.impliedVol(), T = o.tenor, K = o.strike, r = o.r;
+		const double w = o.isCall ? 1.0 : -1.0;
+		const double d1 = o.d_plus(100.0, sigma, r), d2 = o.d_minus(100.0, sigma, r);
+		// put prices by parity from the scalar call formula
+		const double price = o.PriceByBSFormula(100.0, sigma, r) - (o.isCall ? 0.0 : 100.0 - K * exp(-r * T));
+		EXPECT_NEAR(out.price[i], price, 1e-10);
+		EXPECT_NEAR(out.delta[i], o.DeltaByBSFormula(100.0, sigma, r) - (o.isCall ? 0.0 : 1.0), 1e-6);
+		EXPECT_NEAR(out.vega[i], o.VegaByBSFormula(100.0, sigma, r), 1e-8);
+		EXPECT_NEAR(out.gamma[i], normalDens(d1) / (100.0 * sigma * sqrt(T)), 1e-10);
+		EXPECT_NEAR(out.rho[i], w * K * T * exp(-r * T) * N(w * d2), 1e-10);
+		EXPECT_NEAR(out.theta[i], -100.0 * normalDens(d1) * sigma / (2.0 * sqrt(T)) - w * r * K * exp(-r * T) * N(w * d2), 1e-10);
+	}
+}
+
+TEST(PricerTests, BatchImpliedVolRoundTrips) {
+	// puts and calls, deep out of and in the money, short and long dated
+	OptionChain chain;
+	for (int i = 0; i < 203; i++) {
+		const double K = 40.0 + 1.2 * i, T = 0.05 + 0.15 * (i % 13), r = 0.01 * (i % 6), sigma = 0.05 + 0.04 * (i % 11);
+		chain.push_back(100.0, K, T, r, sigma, i % 2 == 0);
+	}
+	ChainGreeks out;
+	PriceByBSFormula(chain, out);
+	std::vector<double> vols(chain.vol.begin(), chain.vol.begin() + chain.size());
+	std::vector<impliedVolStatus> status;
+	fill(chain.vol.begin(), chain.vol.end(), 0.0);
+	ImpliedVolByBSFormula(chain, out.price.data(), status);
+	for (size_t i = 0; i < chain.size(); i++) {
+		// deep in the money, the time value is lost in the rounding of the price and carries no vol information
+		const double intrinsic = max(0.0, chain.isCall[i] * (100.0 - chain.strike[i] * exp(-chain.rate[i] * chain.tenor[i])));
+		if (out.price[i] - intrinsic < 1e-4 * out.price[i]) continue;
+		EXPECT_EQ(status[i], IVConverged) << i;
+		EXPECT_NEAR(chain.vol[i], vols[i], 1e-9 * vols[i]) << i;
+	}
+
+	// arbitrage bounds
+	OptionChain bounds;
+	bounds.push_back(100.0, 80.0, 1.0, 0.0, 0.0, true);
+	bounds.push_back(100.0, 120.0, 1.0, 0.0, 0.0, false);
+	bounds.push_back(100.0, 100.0, 1.0, 0.0, 0.0, true);
+	const double prices[] = { 19.0, 19.5, 100.0 };
+	ImpliedVolByBSFormula(bounds, prices, status);
+	EXPECT_EQ(status[0], IVBelowIntrinsic);
+	EXPECT_EQ(bounds.vol[0], 0.0);
+	EXPECT_EQ(status[1], IVBelowIntrinsic);
+	EXPECT_EQ(status[2], IVAboveMaximum);
+	EXPECT_TRUE(std::isnan(bounds.vol[2]));
+}
+
+static SVISlice MakeSVISlice(double T, const SVIParameters& p) {
+	SVISlice slice;
+	slice.maturity = T;
+	slice.forward = 100.0;
+	for (int i = 0; i < 40; i++) {
+		slice.strikes.push_back(50.0 + 2.5 * i);
+		slice.vols.push_back(sqrt(p.TotalVariance(log(slice.strikes.back() / 100.0)) / T));
+	}
+	return slice;
+}
+
+TEST(PricerTests, SVISurfaceFitsAndWarmStarts) {
+	std::vector<SVISlice> slices;
+	std::vector<SVIParameters> exact;
+	for (double T : { 0.05, 0.1, 0.25, 0.5, 1.0, 2.0, 5.0 }) {
+		SVIParameters p;
+		p.a = 0.02 * T; p.b = 0.15 * T / (0.5 + T); p.rho = -0.6 + 0.02 * T; p.m = 0.02; p.sigma = 0.15 + 0.02 * T;
+		exact.push_back(p);
+		slices.push_back(MakeSVISlice(T, p));
+	}
+	SVISurface surface;
+	surface.numThreads = 3;
+	surface.Calibrate(slices);
+	ASSERT_EQ(surface.Slices(), slices.size());
+	unsigned int coldIterations = 0;
+	for (size_t i = 0; i < slices.size(); i++) {
+		EXPECT_LT(surface.RMSError(i), 1e-9);
+		EXPECT_NEAR(surface.Parameters(i).rho, exact[i].rho, 1e-4);
+		EXPECT_NEAR(surface.Parameters(i).sigma, exact[i].sigma, 1e-4);
+		EXPECT_NEAR(surface.ImpliedVol(80.0, 100.0, slices[i].maturity), slices[i].vols[12], 1e-7);
+		coldIterations += surface.Iterations(i);
+	}
+
+	// next day: one day less to every expiry, spot vols 1% up, from the previous surface
+	for (auto& slice : slices) {
+		slice.maturity -= 1.0 / 365.0;
+		for (auto& v : slice.vols) v *= 1.01;
+	}
+	surface.Calibrate(slices);
+	unsigned int warmIterations = 0;
+	for (size_t i = 0; i < slices.size(); i++) {
+		EXPECT_LT(surface.RMSError(i), 1e-6);
+		warmIterations += surface.Iterations(i);
+	}
+	EXPECT_LT(warmIterations, coldIterations);
+}
+
+TEST(PricerTests, SVISurfaceRemovesCalendarArbitrage) {
+	SVIParameters shortSmile, longSmile;
+	shortSmile.a = 0.01; shortSmile.b = 0.1; shortSmile.rho = -0.7; shortSmile.m = 0.0; shortSmile.sigma = 0.1;
+	// more ATM variance but flatter wings: below the short expiry in the put wing
+	longSmile.a = 0.025; longSmile.b = 0.04; longSmile.rho = 0.0; longSmile.m = 0.0; longSmile.sigma = 0.2;
+	std::vector<SVISlice> slices = { MakeSVISlice(0.5, shortSmile), MakeSVISlice(0.6, longSmile) };
+
+	SVISurface surface;
+	surface.Calibrate(slices);
+	EXPECT_TRUE(surface.CalendarRefit(1));
+	EXPECT_FALSE(surface.CalendarRefit(0));
+	EXPECT_LT(surface.CalendarViolation(0), 1e-7);
+	// over the quotes
+	for (double k = -0.69; k < 0.39; k += 0.01)
+		EXPECT_GE(surface.TotalVariance(k, 0.6) - surface.TotalVariance(k, 0.5), -1e-7);
+	EXPECT_LT(surface.RMSError(0), 1e-9);
+}
+
+TEST(PricerTests, BachelierFormulaMatchesMCAndRoundTrips) {
+	// normal vol of 20 on a spot of 100
+	EurOption call = MakeCall(100.0, 105.0, 1.0, 0.03, 20.0);
+	BachelierModel model(&call);
+	model.CalculateMC(200000, 1);
+	const double mc = call.getPremium(), error = model.PricingError;
+	model.CalculateByFormula();
+	EXPECT_NEAR(call.getPremium(), mc, 4 * error);
+	EXPECT_NEAR(model.delta, N((100.0 * exp(0.03) - 105.0) / (model.ForwardVol())), 1e-12);
+
+	// a copy keeps the base fields: seed and the results
+	model.seed = 5;
+	BachelierModel copy(model);
+	EXPECT_EQ(copy.seed, 5u);
+	EXPECT_EQ(copy.delta, model.delta);
+	EXPECT_EQ(copy.PricingError, model.PricingError);
+
+	OptionChain chain;
+	for (int i = 0; i < 61; i++)
+		chain.push_back(100.0, 40.0 + 2.0 * i, 0.1 + 0.1 * (i % 10), 0.01 * (i % 4), 2.0 + 0.5 * (i % 13), i % 3 != 0);
+	ChainGreeks out;
+	PriceByBachelierFormula(chain, out);
+
+	// Greeks against bumps of the chain formula
+	auto bumped = [&](size_t i, double dS, double dVol, double dT, double dr) {
+		OptionChain one;
+		one.push_back(chain.spot[i] + dS, chain.strike[i], chain.tenor[i] + dT, chain.rate[i] + dr, chain.vol[i] + dVol, chain.isCall[i] > 0);
+		ChainGreeks g;
+		PriceByBachelierFormula(one, g);
+		return g.price[0];
+	};
+	for (size_t i = 0; i < chain.size(); i += 7) {
+		const double h = 1e-4;
+		EXPECT_NEAR(out.delta[i], (bumped(i, h, 0, 0, 0) - bumped(i, -h, 0, 0, 0)) / (2 * h), 1e-6);
+		EXPECT_NEAR(out.gamma[i], (bumped(i, 1e-2, 0, 0, 0) - 2 * out.price[i] + bumped(i, -1e-2, 0, 0, 0)) * 1e4, 1e-5);
+		EXPECT_NEAR(out.vega[i], (bumped(i, 0, h, 0, 0) - bumped(i, 0, -h, 0, 0)) / (2 * h), 1e-6);
+		EXPECT_NEAR(out.theta[i], -(bumped(i, 0, 0, h, 0) - bumped(i, 0, 0, -h, 0)) / (2 * h), 1e-5);
+		EXPECT_NEAR(out.rho[i], (bumped(i, 0, 0, 0, h) - bumped(i, 0, 0, 0, -h)) / (2 * h), 1e-4);
+	}
+
+	std::vector<double> vols(chain.vol.begin(), chain.vol.begin() + chain.size());
+	std::vector<impliedVolStatus> status;
+	ImpliedNormalVolByBachelierFormula(chain, out.price.data(), status);
+	for (size_t i = 0; i < chain.size(); i++) {
+		const double F = 100.0 * exp(chain.rate[i] * chain.tenor[i]);
+		const double intrinsic = max(0.0, chain.isCall[i] * (F - chain.strike[i])) * exp(-chain.rate[i] * chain.tenor[i]);
+		// deep in the money the time value is lost in the rounding of the price, far out of it the price underflows
+		if (out.price[i] - intrinsic < 1e-3 * out.price[i] || out.price[i] < 1e-300) continue;
+		EXPECT_EQ(status[i], IVConverged) << i;
+		EXPECT_NEAR(chain.vol[i], vols[i], 1e-12 * vols[i]) << i;
+	}
+
+	OptionChain bounds;
+	bounds.push_back(100.0, 90.0, 1.0, 0.0, 0.0, true);
+	bounds.push_back(100.0, 100.0, 2.0, 0.0, 0.0, false);
+	const double prices[] = { 9.5, 4.0 };
+	ImpliedNormalVolByBachelierFormula(bounds, prices, status);
+	EXPECT_EQ(status[0], IVBelowIntrinsic);
+	EXPECT_EQ(status[1], IVConverged);
+	EXPECT_NEAR(bounds.vol[1], 4.0 * sqrt(2.0 * M_PI) / sqrt(2.0), 1e-12);
+}
+
+TEST(PricerTests, InlinePayoffMCMatchesVirtual) {
+	EurOption call = MakeCall(), put = MakeCall();
+	put.isCall = false;
+	BSModel model(&call);
+	model.seed = 5;
+	model.CalculateMC(20000, 4, 0.0001, false, 2, PseudoRandom, Antithetic);
+	const double premium = call.getPremium(), error = model.PricingError, delta = model.delta;
+	model.CalculateMCInline<EurOption>(20000, 4, 0.0001, false, 2, PseudoRandom, Antithetic);
+	EXPECT_EQ(call.getPremium(), premium);
+	EXPECT_EQ(model.PricingError, error);
+	EXPECT_EQ(model.delta, delta);
+
+	// call - put, composed at run time and at compile time
+	DifferenceOfOptions dynamicSpread(1.0, 1.0, &call, &put);
+	dynamicSpread.r = 0.05;
+	StaticDifferenceOfOptions<EurOption, EurOption> staticSpread(1.0, 1.0, &call, &put);
+	BSModel dynamicModel(&dynamicSpread), staticModel(&staticSpread);
+	dynamicModel.Update_Params(0.05, 0.2);
+	staticModel.Update_Params(0.05, 0.2);
+	dynamicModel.CalculateMC(8192, 3);
+	staticModel.CalculateMCInline<StaticDifferenceOfOptions<EurOption, EurOption>>(8192, 3);
+	EXPECT_EQ(staticSpread.getPremium(), dynamicSpread.getPremium());
+	EXPECT_NEAR(staticSpread.getPremium(), 100.0 - 100.0 * exp(-0.05), 4 * staticModel.PricingError);
+
+	EXPECT_THROW(dynamicModel.CalculateMCInline<EurOption>(1024), std::invalid_argument);
+}
+
+TEST(PricerTests, PayoffScriptMatchesHandWrittenPayoffs) {
+	Asset underlyer;
+	underlyer.updatePx(100.0);
+	const std::map<std::string, double> terms = { { "K", 100.0 }, { "K2", 110.0 }, { "B", 130.0 } };
+
+	// vanilla and call spread, against EurOption and DifferenceOfOptions on the same paths
+	EurOption call = MakeCall(), upper = MakeCall(100.0, 110.0);
+	ScriptedOption scriptedCall({ underlyer }, "max(S - K, 0)", terms, 1.0, 1.0, 0.05, 0.2);
+	ScriptedOption scriptedSpread({ underlyer }, "max(S[-1] - K, 0) - max(S - K2, 0)", terms, 1.0, 1.0, 0.05, 0.2);
+	DifferenceOfOptions spread(1.0, 1.0, &call, &upper);
+	spread.r = 0.05;
+	std::vector<std::pair<Option*, Option*>> pairs = { { &call, &scriptedCall }, { &spread, &scriptedSpread } };
+	for (auto& pair : pairs) {
+		BSModel written(pair.first), scripted(pair.second);
+		written.Update_Params(0.05, 0.2);
+		scripted.Update_Params(0.05, 0.2);
+		written.seed = scripted.seed = 9;
+		written.CalculateMCBlock(4096, 4, 0.0001, 2);
+		scripted.CalculateMCBlock(4096, 4, 0.0001, 2);
+		EXPECT_EQ(pair.second->getPremium(), pair.first->getPremium());
+		EXPECT_EQ(scripted.delta, written.delta);
+	}
+
+	// Asian, up-and-out and digital payoffs: block kernels against the per-path interpreter and hand-written code
+	BSModel model(&call);
+	PathBlock block(12, BSModel::pathBlockSize);
+	model.GeneratePathBlock(1.0, 12, 0, block);
+	ScriptedOption asian({ underlyer }, "max(avg() - K, 0)", terms);
+	ScriptedOption barrier({ underlyer }, "max(S - K, 0) * (pathmax() < B)", terms);
+	ScriptedOption window({ underlyer }, "min(avg(3, 5), pathmin(0, -2), S[2]) + abs(-S[0] + K) / 2 - (S >= K)", terms);
+	std::vector<double> out(block.paths());
+	PayoffScratch scratch;
+	SamplePath path(block.steps());
+	for (ScriptedOption* option : { &asian, &barrier, &window }) {
+		option->PayoffBlock(block, out.data(), scratch);
+		for (size_t p = 0; p < block.paths(); p++) {
+			double sum = 0.0, high = block(0, p), low = block(0, p);
+			for (size_t k = 0; k < block.steps(); k++) {
+				path[k] = block(k, p);
+				sum += path[k];
+				high = std::max(high, path[k]);
+				if (k + 1 < block.steps()) low = std::min(low, path[k]);
+			}
+			double expected = std::max(sum / 12 - 100.0, 0.0);
+			if (option == &barrier) expected = high < 130.0 ? std::max(path[11] - 100.0, 0.0) : 0.0;
+			if (option == &window)
+				expected = std::min({ (path[3] + path[4] + path[5]) / 3, low, path[2] }) + std::abs(100.0 - path[0]) / 2 - (path[11] >= 100.0);
+			EXPECT_NEAR(out[p], expected, 1e-12);
+			EXPECT_EQ(option->Payoff(path), out[p]);
+		}
+	}
+
+	// constants are folded, constant operands become immediates
+	EXPECT_EQ(PayoffProgram::Compile("max(S - K, 0)", terms).Code().size(), 3u);
+	EXPECT_EQ(PayoffProgram::Compile("max(K - S, 0) * (2 * 3 - 1)", terms).Code().size(), 4u);
+	EXPECT_EQ(PayoffProgram::Compile("-(K2 - K) / 4", terms).Code()[0].value, -2.5);
+	ScriptedOption put({ underlyer }, "max(K - S, 0) * (2 * 3 - 1)", terms);
+	put.PayoffBlock(block, out.data(), scratch);
+	EXPECT_EQ(out[7], std::max(100.0 - block(11, 7), 0.0) * 5);
+
+	EXPECT_THROW(PayoffProgram::Compile("max(S - K, 0"), std::invalid_argument);
+	EXPECT_THROW(PayoffProgram::Compile("max(S - X, 0)", terms), std::invalid_argument);
+	EXPECT_THROW(PayoffProgram::Compile("max(S)"), std::invalid_argument);
+	EXPECT_NO_THROW(asian.Program().Evaluate(path.data(), 3));
+	EXPECT_THROW(window.Program().Evaluate(path.data(), 4), std::out_of_range);
+}
+
+TEST(PricerTests, LSMCPricesAmericanAndBermudanOptions) {
+	// Longstaff & Schwartz (2001), table 1: American put S = 36, K = 40, vol 0.2, r 0.06, T = 1, 50 dates a year,
+	// finite difference value 4.478
+	EurOption put = MakeCall(36.0, 40.0, 1.0, 0.06, 0.2);
+	put.isCall = false;
+	put.setStyle(American);
+	BSModel model(&put);
+	model.seed = 11;
+	LSMCEngine engine(model);
+	engine.numThreads = 3;
+	engine.Calculate(40000, 50);
+	const double premium = put.getPremium(), error = model.PricingError, delta = model.delta;
+	EXPECT_NEAR(premium, 4.478, 3 * error + 0.01);
+	EXPECT_GT(engine.EarlyExerciseProbability(), 0.3);
+	EXPECT_FALSE(engine.ImmediateExercise());
+	// binomial tree delta -0.695
+	EXPECT_NEAR(delta, -0.695, 0.02);
+
+	// same results on one thread, and from the kept regressions
+	engine.numThreads = 1;
+	engine.Calculate(40000, 50);
+	EXPECT_EQ(put.getPremium(), premium);
+	EXPECT_EQ(model.PricingError, error);
+	EXPECT_EQ(model.delta, delta);
+	const std::vector<double> beta = engine.Coefficients(20);
+	engine.Calculate(40000, 50, 0.0001, true);
+	EXPECT_EQ(put.getPremium(), premium);
+	EXPECT_EQ(engine.Coefficients(20), beta);
+
+	// bump and revalue with the regressions kept agrees with the pathwise delta
+	put.underlyers[0].updatePx(36.0 * 1.01);
+	engine.Calculate(40000, 50, 0.0001, true);
+	EXPECT_EQ(engine.Coefficients(20), beta);
+	EXPECT_NEAR((put.getPremium() - premium) / 0.36, delta, 0.03);
+
+	// deep in the money, an American put is exercised at once
+	put.underlyers[0].updatePx(20.0);
+	engine.Calculate(4096, 10);
+	EXPECT_TRUE(engine.ImmediateExercise());
+	EXPECT_EQ(put.getPremium(), 20.0);
+
+	// with its only exercise date at maturity a Bermudan option is European,
+	// and an American call without dividends is worth its European price
+	EurOption call = MakeCall(), bermudan = MakeCall();
+	bermudan.setStyle(Bermudan);
+	BSModel bermudanModel(&bermudan);
+	LSMCEngine(bermudanModel).Calculate(20000, 1);
+	EXPECT_NEAR(bermudan.getPremium(), call.PriceByBSFormula(100.0, 0.2, 0.05), 3 * bermudanModel.PricingError);
+	bermudan.setStyle(American);
+	LSMCEngine(bermudanModel).Calculate(20000, 20);
+	EXPECT_NEAR(bermudan.getPremium(), call.PriceByBSFormula(100.0, 0.2, 0.05), 3 * bermudanModel.PricingError + 0.05);
+
+	// a European option is only exercised at maturity, whatever the dates asked for: the Bermudan of one date
+	bermudan.setStyle(Bermudan);
+	LSMCEngine(bermudanModel).Calculate(20000, 1);
+	const double oneDate = bermudan.getPremium();
+	bermudan.setStyle(European);
+	LSMCEngine(bermudanModel).Calculate(20000, 50);
+	EXPECT_EQ(bermudan.getPremium(), oneDate);
+	// on the put, where the dates would be worth something (PriceByBSFormula is the call, put by parity)
+	put.underlyers[0].updatePx(36.0);
+	put.setStyle(European);
+	engine.Calculate(40000, 50);
+	const double europeanPut = put.PriceByBSFormula(36.0, 0.2, 0.06) - 36.0 + 40.0 * exp(-0.06);
+	EXPECT_NEAR(put.getPremium(), europeanPut, 3 * model.PricingError);
+
+	put.setStyle(Asian);
+	EXPECT_THROW(engine.Calculate(40000, 50), std::invalid_argument);
+}
+
+TEST(PricerTests, PDEMatchesBlackScholesAndPricesAmericanPuts) {
+	EurOption call = MakeCall();
+	call.use_MC = false;
+	BSModel model(&call);
+	model.Calculate();
+	const double sqrtT = 1.0, d1 = (log(1.0) + 0.05 + 0.02) / 0.2, d2 = d1 - 0.2 * sqrtT;
+	EXPECT_NEAR(call.getPremium(), call.PriceByBSFormula(100.0, 0.2, 0.05), 2e-3);
+	EXPECT_NEAR(model.delta, normalCdf(d1), 1e-4);
+	EXPECT_NEAR(model.gamma, normalDens(d1) / (100.0 * 0.2), 1e-5);
+	EXPECT_NEAR(model.theta, -100.0 * normalDens(d1) * 0.2 / 2.0 - 0.05 * 100.0 * exp(-0.05) * normalCdf(d2), 2e-3);
+	EXPECT_EQ(model.PricingError, 0.0);
+
+	// the grid is kept: solving again does not allocate
+	const size_t allocations = allocationCount;
+	model.CalculatePDE();
+	EXPECT_EQ(allocationCount, allocations);
+
+	// American put of Longstaff & Schwartz, binomial tree (4000 steps) 4.4867, delta -0.6948
+	EurOption put = MakeCall(36.0, 40.0, 1.0, 0.06, 0.2);
+	put.isCall = false;
+	put.setStyle(American);
+	put.use_MC = false;
+	BSModel putModel(&put);
+	putModel.Calculate();
+	EXPECT_NEAR(put.getPremium(), 4.4867, 5e-4);
+	EXPECT_NEAR(putModel.delta, -0.6948, 3e-3);
+	EXPECT_GT(putModel.gamma, 0.0);
+
+	// deep in the money it is worth its exercise value, and more than the European put
+	put.underlyers[0].updatePx(25.0);
+	putModel.CalculatePDE();
+	EXPECT_NEAR(put.getPremium(), 15.0, 1e-6);
+	EXPECT_EQ(putModel.theta, 0.0);
+	put.setStyle(European);
+	putModel.CalculatePDE();
+	EXPECT_LT(put.getPremium(), 15.0);
+
+	// Bermudan: exercise on the dates only, as on the lattice
+	put.underlyers[0].updatePx(36.0);
+	put.setStyle(Bermudan);
+	putModel.pde.exerciseDates = 4;
+	LatticeEngine lattice(putModel);
+	lattice.exerciseDates = 4;
+	lattice.steps = 2000;
+	lattice.Calculate();
+	const double latticePrice = put.getPremium();
+	putModel.Calculate();
+	EXPECT_NEAR(put.getPremium(), latticePrice, 2e-3);
+	put.setStyle(European);
+	putModel.Calculate();
+	EXPECT_LT(put.getPremium(), latticePrice - 0.1);
+	put.setStyle(American);
+	putModel.Calculate();
+	EXPECT_GT(put.getPremium(), latticePrice + 0.01);
+
+	// no PDE for Asian payoffs or for contracts other than vanillas
+	put.setStyle(Asian);
+	EXPECT_THROW(putModel.Calculate(), std::invalid_argument);
+	EurOption upper = MakeCall(100.0, 110.0);
+	DifferenceOfOptions spread(1.0, 1.0, &call, &upper);
+	spread.use_MC = false;
+	BSModel spreadModel(&spread);
+	EXPECT_THROW(spreadModel.Calculate(), std::invalid_argument);
+}
+
+TEST(PricerTests, LatticeMatchesBlackScholesAndPricesAmericanPuts) {
+	EurOption call = MakeCall();
+	BSModel model(&call);
+	LatticeEngine lattice(model);
+	const double d1 = (log(1.0) + 0.05 + 0.02) / 0.2, d2 = d1 - 0.2;
+	const double bs = call.PriceByBSFormula(100.0, 0.2, 0.05);
+	const double theta = -100.0 * normalDens(d1) * 0.2 / 2.0 - 0.05 * 100.0 * exp(-0.05) * normalCdf(d2);
+	for (latticeType type : { CRR, LeisenReimer, Trinomial })
+	{
+		lattice.type = type;
+		lattice.Calculate();
+		EXPECT_NEAR(call.getPremium(), bs, type == LeisenReimer ? 1e-4 : 1e-2) << type;
+		EXPECT_NEAR(model.delta, normalCdf(d1), 2e-3) << type;
+		EXPECT_NEAR(model.gamma, normalDens(d1) / (100.0 * 0.2), 2e-4) << type;
+		EXPECT_NEAR(model.theta, theta, 2e-2) << type;
+		EXPECT_EQ(model.PricingError, 0.0);
+	}
+
+	// American put of Longstaff & Schwartz, binomial tree (4000 steps) 4.4867, delta -0.6948
+	EurOption put = MakeCall(36.0, 40.0, 1.0, 0.06, 0.2);
+	put.isCall = false;
+	put.setStyle(American);
+	BSModel putModel(&put);
+	LatticeEngine putLattice(putModel);
+	for (latticeType type : { CRR, LeisenReimer, Trinomial })
+	{
+		putLattice.type = type;
+		putLattice.Calculate();
+		EXPECT_NEAR(put.getPremium(), 4.4867, 2e-3) << type;
+		EXPECT_NEAR(putModel.delta, -0.6948, 3e-3) << type;
+	}
+
+	// Bermudan lies between European and American, and with an exercise date per step is American
+	putLattice.type = CRR;
+	putLattice.Calculate();
+	const double american = put.getPremium();
+	put.setStyle(European);
+	putLattice.Calculate();
+	const double european = put.getPremium();
+	put.setStyle(Bermudan);
+	putLattice.exerciseDates = 4;
+	putLattice.Calculate();
+	EXPECT_GT(put.getPremium(), european);
+	EXPECT_LT(put.getPremium(), american);
+	putLattice.exerciseDates = putLattice.steps;
+	putLattice.Calculate();
+	EXPECT_NEAR(put.getPremium(), american, 1e-12);
+
+	// one sweep over a strip of strikes gives the prices of sweeps strike by strike
+	put.setStyle(American);
+	const vector<double> strikes = { 30.0, 34.0, 36.0, 38.0, 40.0, 44.0, 50.0 };
+	for (latticeType type : { CRR, LeisenReimer, Trinomial })
+	{
+		putLattice.type = type;
+		vector<double> prices;
+		putLattice.CalculateStrikes(strikes, prices);
+		ASSERT_EQ(prices.size(), strikes.size());
+		for (size_t k = 0; k < strikes.size(); k++)
+		{
+			put.strike = strikes[k];
+			putLattice.Calculate();
+			EXPECT_EQ(prices[k], put.getPremium()) << type << " " << strikes[k];
+		}
+		put.strike = 40.0;
+	}
+}